@@ -0,0 +1,76 @@
+#pragma once
+
+#include <evol/common/ev_types.h>
+
+#include <atomic>
+#include <mutex>
+
+// Per-world block arena for Bullet's `btAlignedAlloc`. The capacity is
+// reserved up front and carved into power-of-two blocks, which go back to a
+// per-size free list when released, so once a world has warmed up its steps
+// are served entirely from recycled blocks.
+//
+// Bullet only has one global allocation hook. `install` routes it through
+// the arena made current on the calling thread with `setCurrent`, and falls
+// back to plain malloc when there is none, the request is too large or the
+// arena is full. Arena blocks are recognised by address, so memory can be
+// freed from any thread and after the scope that allocated it has ended,
+// and heap blocks stay compatible with Bullet's default allocator: the hook
+// can go in after Bullet has allocated and come out once no arena is left.
+//
+// Only allocations made on a thread with a current arena are served from
+// it; Bullet's worker threads always allocate from the heap.
+class EvArena
+{
+public:
+  EvArena(size_t capacity);
+
+  EvArena(const EvArena&) = delete;
+  EvArena& operator=(const EvArena&) = delete;
+
+  // Frees the arena once the last block allocated from it is released
+  void release();
+
+  // Requests that fell back to the heap while the arena was current
+  U64 getOverflowCount() const {
+    return overflowCount;
+  }
+
+  // Both idempotent. `uninstall` keeps the hook while any arena is alive,
+  // their blocks can't be handed to free().
+  static void install();
+  static void uninstall();
+
+  // Returns the previously current arena
+  static EvArena *setCurrent(EvArena *arena);
+
+private:
+  ~EvArena();
+
+  void *allocate(size_t size);
+  void deallocate(void *block, U32 sizeClass);
+
+  static EvArena *findOwner(void *memblock);
+
+  static void *allocFunc(size_t size);
+  static void freeFunc(void *memblock);
+
+  static constexpr U32 MIN_SIZE_CLASS = 5;
+  static constexpr U32 MAX_SIZE_CLASS = 16;
+
+  struct FreeBlock {
+    FreeBlock *next;
+  };
+
+  unsigned char *memory;
+  size_t capacity;
+  // Position in the live arena registry, -1 if it was full
+  I32 slot;
+  size_t offset;
+  FreeBlock *freeLists[MAX_SIZE_CLASS + 1];
+
+  U64 liveBlocks;
+  bool released;
+  std::atomic<U64> overflowCount;
+  std::mutex mtx;
+};
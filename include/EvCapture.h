@@ -0,0 +1,248 @@
+#pragma once
+
+#include <evol/common/ev_types.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+// Record types of a capture. The values are stored in the log, so new ones
+// are only ever appended.
+enum EvCaptureOp : U16 {
+  EV_CAPTURE_SCENE_WORLD = 1,
+  EV_CAPTURE_OBJECT_TRANSFORM,
+
+  EV_CAPTURE_WORLD_NEW,
+  EV_CAPTURE_WORLD_DESTROY,
+  EV_CAPTURE_WORLD_PROGRESS,
+  EV_CAPTURE_WORLD_SETSUBSTEPS,
+  EV_CAPTURE_WORLD_SETSOLVERPARAMS,
+  EV_CAPTURE_WORLD_FREEZESTATICS,
+  EV_CAPTURE_WORLD_ADDANCHOR,
+  EV_CAPTURE_WORLD_SETANCHORPOSITION,
+  EV_CAPTURE_WORLD_REMOVEANCHOR,
+  EV_CAPTURE_WORLD_SETSTREAMINGRADIUS,
+  EV_CAPTURE_WORLD_SETLODDISTANCES,
+  EV_CAPTURE_WORLD_SETCONTACTREPORT,
+  EV_CAPTURE_WORLD_SETDETERMINISTIC,
+
+  EV_CAPTURE_SHAPE_BOX,
+  EV_CAPTURE_SHAPE_SPHERE,
+  EV_CAPTURE_SHAPE_CAPSULE,
+  EV_CAPTURE_SHAPE_MESH,
+  EV_CAPTURE_SHAPE_MESHASYNC,
+  EV_CAPTURE_SHAPE_CONVEXHULL,
+  EV_CAPTURE_SHAPE_COMPOUND,
+  EV_CAPTURE_SHAPE_DECOMPOSEDMESH,
+  EV_CAPTURE_SHAPE_HEIGHTFIELD,
+  EV_CAPTURE_SHAPE_DESTROY,
+  EV_CAPTURE_SHAPE_SETCACHEDIRECTORY,
+
+  EV_CAPTURE_RIGIDBODY_NEW,
+  EV_CAPTURE_RIGIDBODY_DESTROY,
+  EV_CAPTURE_RIGIDBODY_DESTROYBATCH,
+  EV_CAPTURE_RIGIDBODY_SETPOSITION,
+  EV_CAPTURE_RIGIDBODY_SETVELOCITY,
+  EV_CAPTURE_RIGIDBODY_SETROTATIONEULER,
+  EV_CAPTURE_RIGIDBODY_ADDFORCE,
+
+  EV_CAPTURE_CHARACTER_NEW,
+  EV_CAPTURE_CHARACTER_DESTROY,
+  EV_CAPTURE_CHARACTER_MOVE,
+  EV_CAPTURE_CHARACTER_MOVEBATCH,
+  EV_CAPTURE_CHARACTER_JUMP,
+
+  EV_CAPTURE_CONSTRAINT_NEWBATCH,
+  EV_CAPTURE_CONSTRAINT_DESTROY,
+  EV_CAPTURE_CONSTRAINT_SETENABLED,
+
+  EV_CAPTURE_RAYTEST,
+
+  EV_CAPTURE_SOFTBODY_NEWCLOTH,
+  EV_CAPTURE_SOFTBODY_DESTROY,
+  EV_CAPTURE_SOFTBODY_PINVERTEX,
+  EV_CAPTURE_SOFTBODY_UNPINVERTEX,
+
+  EV_CAPTURE_VEHICLE_NEW,
+  EV_CAPTURE_VEHICLE_DESTROY,
+  EV_CAPTURE_VEHICLE_SETCONTROLS,
+  EV_CAPTURE_VEHICLE_SETCONTROLSBATCH,
+};
+
+// A game object's transform as the game hands it out, column major
+struct EvCaptureMatrix {
+  F32 m[16];
+};
+
+// Arrays are stored as a count followed by the elements, aligned to 8 bytes
+// within the record so the reader can hand them out in place
+template<typename T>
+struct EvCaptureArray {
+  const T *data;
+  U32 count;
+};
+
+template<typename T>
+inline EvCaptureArray<T>
+evCaptureArray(
+    const T *data,
+    U32 count)
+{
+  return { data, count };
+}
+
+#define EV_CAPTURE(...) do { \
+    if(EvCapture::isActive()) { \
+      EvCapture::record(__VA_ARGS__); \
+    } \
+  } while (0)
+
+// Binary log of the calls made into the module, for replaying a session's
+// physics offline. A record is the opcode, the payload size and the call's
+// arguments as raw bytes; calls that create something also store the handle
+// they returned so the replay can map it to its own. Handles are pointers,
+// so a capture only replays on the architecture it was recorded on.
+//
+// Records are serialized on the calling thread and appended to a shared
+// buffer under a lock, which goes to the file whenever it fills up. While no
+// capture is running, `EV_CAPTURE` costs a single relaxed load.
+class EvCapture
+{
+public:
+  static bool start(const char *path);
+
+  // Flushes and closes the log. Calls still in flight are dropped.
+  static void stop();
+
+  static inline bool isActive() {
+    return active.load(std::memory_order_relaxed);
+  }
+
+  template<typename... Args>
+  static void record(EvCaptureOp op, const Args&... args)
+  {
+    static thread_local std::vector<U8> payload;
+    payload.clear();
+    int unused[] = { 0, (put(payload, args), 0)... };
+    (void)unused;
+    append(op, payload);
+  }
+
+  // The game is only asked which world a scene uses, so the answer is logged
+  // whenever it changes
+  static void recordSceneWorld(U64 scene, U64 world);
+
+  // Logged when the game hands out a transform that differs from the last
+  // one seen for that object, which keeps idle kinematic bodies out of the log
+  static void recordTransform(U64 scene, U64 object, const F32 *matrix);
+
+  static constexpr U32 MAGIC = 0x50435645; // "EVCP"
+  static constexpr U16 VERSION = 1;
+
+  struct FileHeader {
+    U32 magic;
+    U16 version;
+    U16 pointerSize;
+  };
+
+  struct RecordHeader {
+    U16 op;
+    U16 reserved;
+    U32 size;
+  };
+
+private:
+  template<typename T>
+  static void put(std::vector<U8> &out, const T &value)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "Captured arguments are stored as raw bytes");
+    const U8 *bytes = reinterpret_cast<const U8*>(&value);
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+  }
+
+  // Stored with the terminator so the reader can return it in place
+  static void put(std::vector<U8> &out, const char *str)
+  {
+    U32 length = str != nullptr ? U32(strlen(str)) + 1 : 0;
+    put(out, length);
+    if(length > 0) {
+      out.insert(out.end(), str, str + length);
+    }
+  }
+
+  template<typename T>
+  static void put(std::vector<U8> &out, const EvCaptureArray<T> &array)
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "Captured arguments are stored as raw bytes");
+    put(out, array.count);
+    out.resize((out.size() + 7) & ~size_t(7));
+    const U8 *bytes = reinterpret_cast<const U8*>(array.data);
+    out.insert(out.end(), bytes, bytes + sizeof(T) * array.count);
+  }
+
+  static void append(EvCaptureOp op, const std::vector<U8> &payload);
+  static void flush();
+
+  static std::atomic<bool> active;
+};
+
+// Reads a capture back one record at a time. Values are taken off the
+// current record in the order they were written; reading past its end
+// yields zeroes.
+class EvCaptureReader
+{
+public:
+  EvCaptureReader();
+  ~EvCaptureReader();
+
+  EvCaptureReader(const EvCaptureReader&) = delete;
+  EvCaptureReader& operator=(const EvCaptureReader&) = delete;
+
+  // Fails if the file is missing, isn't a capture or was recorded with a
+  // different version or pointer size
+  bool open(const char *path);
+
+  // False at the end of the log or on a truncated record
+  bool next(EvCaptureOp &op);
+
+  template<typename T>
+  T get()
+  {
+    static_assert(std::is_trivially_copyable<T>::value, "Captured arguments are stored as raw bytes");
+    T value;
+    if(cursor + sizeof(T) <= payload.size()) {
+      memcpy(&value, &payload[cursor], sizeof(T));
+      cursor += sizeof(T);
+    } else {
+      memset(&value, 0, sizeof(T));
+      cursor = payload.size();
+    }
+    return value;
+  }
+
+  // Valid until the next record is read, nullptr if a null string was captured
+  const char *getString();
+
+  // Points into the record, valid until the next one is read
+  template<typename T>
+  const T *getArray(U32 &count)
+  {
+    count = get<U32>();
+    cursor = (cursor + 7) & ~size_t(7);
+    if(count == 0 || cursor + sizeof(T) * count > payload.size()) {
+      count = 0;
+      cursor = payload.size();
+      return nullptr;
+    }
+    const T *data = reinterpret_cast<const T*>(&payload[cursor]);
+    cursor += sizeof(T) * count;
+    return data;
+  }
+
+private:
+  FILE *file;
+  std::vector<U8> payload;
+  size_t cursor;
+};
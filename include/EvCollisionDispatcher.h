@@ -0,0 +1,20 @@
+#pragma once
+
+#include <BulletCollision/CollisionDispatch/btCollisionDispatcher.h>
+#include <evol/common/ev_types.h>
+
+// Counts the manifolds and collision algorithms that didn't fit in the
+// collision configuration's pools and had to come from the heap instead.
+class EvCollisionDispatcher : public btCollisionDispatcher
+{
+public:
+  U64 manifoldPoolOverflows;
+  U64 algorithmPoolOverflows;
+
+  EvCollisionDispatcher(
+      btCollisionConfiguration *collisionConfiguration);
+
+  btPersistentManifold *getNewManifold(const btCollisionObject *body0, const btCollisionObject *body1) override;
+
+  void *allocateCollisionAlgorithm(int size) override;
+};
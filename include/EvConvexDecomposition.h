@@ -0,0 +1,60 @@
+#pragma once
+
+#include <LinearMath/btAlignedObjectArray.h>
+#include <LinearMath/btVector3.h>
+#include <evol/common/ev_types.h>
+
+#include <vector>
+
+// Approximate convex decomposition of a triangle mesh. The mesh is split
+// along the longest axis of its largest cluster until the hull budget is
+// spent, and every cluster is wrapped in a simplified convex hull.
+// Results can be stored on disk and loaded back so the split only has to be
+// computed once per mesh.
+class EvConvexDecomposition
+{
+public:
+  typedef btAlignedObjectArray<btVector3> Hull;
+
+private:
+  U32 maxHulls;
+  U32 maxVerticesPerHull;
+  std::vector<Hull> hulls;
+
+public:
+  EvConvexDecomposition(
+      U32 maxHulls,
+      U32 maxVerticesPerHull);
+
+  void compute(
+      const btVector3 *vertices,
+      U32 vertexCount,
+      const U32 *indices,
+      U32 indexCount);
+
+  // Key identifying the decomposition of this geometry with these settings
+  U64 hash(
+      const btVector3 *vertices,
+      U32 vertexCount,
+      const U32 *indices,
+      U32 indexCount) const;
+
+  bool load(const char *path);
+  bool save(const char *path) const;
+
+  inline U32 getHullCount() const {
+    return hulls.size();
+  }
+
+  inline const Hull& getHull(U32 idx) const {
+    return hulls[idx];
+  }
+
+  // Convex hull of `points` reduced to at most `maxVertices` vertices by
+  // keeping the support points of evenly spread directions.
+  static void buildSimplifiedHull(
+      const btVector3 *points,
+      U32 pointCount,
+      U32 maxVertices,
+      Hull &hull);
+};
@@ -0,0 +1,159 @@
+#pragma once
+
+#include <btBulletDynamicsCommon.h>
+#include <BulletDynamics/Dynamics/btDiscreteDynamicsWorldMt.h>
+#include <evol/common/ev_types.h>
+
+struct btDbvtBroadphase;
+
+// Motion state of a kinematic body that can tell whether the transform it
+// hands out changed
+class EvPolledMotionState : public btMotionState
+{
+public:
+  // Returns false while the transform is the one the last poll returned,
+  // otherwise fills `transform`
+  virtual bool pollWorldTransform(btTransform &transform) = 0;
+};
+
+// Builds with BT_THREADSAFE solve islands through a pool of solvers
+// dispatched on Bullet's task scheduler, so they run in parallel whenever a
+// multi-threaded scheduler is installed. Other builds keep the plain
+// single-solver world, without the cost of batching islands for nothing.
+#if BT_THREADSAFE
+typedef btDiscreteDynamicsWorldMt EvDynamicsWorldBase;
+#else
+typedef btDiscreteDynamicsWorld EvDynamicsWorldBase;
+#endif
+
+//
+// Kinematic bodies with an EvPolledMotionState are put to sleep while their
+// transform doesn't change, which skips their velocity update, AABB update
+// and broadphase update, and are woken when it changes again. Only non-static
+// objects are visited when AABBs are updated.
+class EvDynamicsWorld : public EvDynamicsWorldBase
+{
+public:
+  // Simulation LOD tiers. Bodies on the lower tiers are only integrated every
+  // `lodInterval` internal ticks, with the time accumulated since their last
+  // tick, and are put in the debris filter group so the narrowphase never
+  // runs between two of them. Ballistic bodies additionally only collide
+  // with static geometry and characters. The body's own filter is restored
+  // when it goes back to LOD_FULL.
+  enum LodTier {
+    LOD_FULL,
+    LOD_REDUCED,
+    LOD_BALLISTIC,
+  };
+
+  // Time spent in the broadphase since the last reset, in microseconds
+  U64 broadphaseTime;
+
+  EvDynamicsWorld(
+      btDispatcher *dispatcher,
+      btBroadphaseInterface *broadphase,
+      // A btConstraintSolverPoolMt under BT_THREADSAFE
+      btConstraintSolver *solver,
+      btCollisionConfiguration *collisionConfiguration);
+
+  // Removes all `objects` from the world in one pass. Overlapping pairs of the
+  // removed proxies are dropped in a single sweep over the pair cache instead
+  // of one sweep per proxy, and the non-static body list is compacted once.
+  // Objects are only detached, freeing them is left to the caller.
+  void removeCollisionObjects(btCollisionObject **objects, int count);
+
+  // Bulk counterpart of removeConstraint, compacting the constraint list once
+  void removeConstraints(btTypedConstraint **constraints, int count);
+
+  // Moves every static object straight into the DBVT's static tree and
+  // rebuilds that tree top-down once. Meant to be called after a level load;
+  // other broadphases are left untouched.
+  void freezeStaticObjects();
+
+  // Puts a static added after `freezeStaticObjects` in the static tree too,
+  // does nothing if the world was never frozen
+  void freezeStaticObject(btCollisionObject *object);
+
+  // Moves `body` to another LOD tier, updating its collision filter. Pairs
+  // the new filter rejects are dropped in one sweep during the next step.
+  void setBodyLod(btRigidBody *body, LodTier tier);
+
+  void setLodInterval(int interval);
+
+  int getNumLodBodies() const {
+    return lodBodies.size();
+  }
+
+  // The transform the last step handed, or would have handed, to `body`'s
+  // motion state
+  void getInterpolatedTransform(const btRigidBody *body, btTransform &transform) const;
+
+  void addRigidBody(btRigidBody *body) override;
+  void addRigidBody(btRigidBody *body, int group, int mask) override;
+  void removeRigidBody(btRigidBody *body) override;
+
+  void addCollisionObject(
+      btCollisionObject *object,
+      int collisionFilterGroup = btBroadphaseProxy::DefaultFilter,
+      int collisionFilterMask = btBroadphaseProxy::AllFilter) override;
+  void removeCollisionObject(btCollisionObject *object) override;
+
+  void updateAabbs() override;
+
+  void computeOverlappingPairs() override;
+
+protected:
+  void internalSingleStepSimulation(btScalar timeStep) override;
+  void saveKinematicState(btScalar timeStep) override;
+
+private:
+  struct HeldBody {
+    btVector3 linearVelocity;
+    btVector3 angularVelocity;
+    // Forces of a scaled body before they were replaced for its turn
+    btVector3 totalForce;
+    btVector3 totalTorque;
+    int activationState;
+    bool held;
+    bool scaled;
+  };
+
+  // A body in the reduced or ballistic tier. Its position in `lodBodies` is
+  // kept in the body's second user index.
+  struct LodBody {
+    btRigidBody *body;
+    // Offset of the body's turn, kept while the body stays in the LOD tiers
+    // so other bodies joining or leaving don't shift it
+    U32 phase;
+    // Forces applied on the body's held steps, handed to it on its turn
+    btVector3 heldImpulse;
+    btVector3 heldTorqueImpulse;
+    // Filter of the body before it left LOD_FULL
+    int filterGroup;
+    int filterMask;
+  };
+
+  struct KinematicBody {
+    btRigidBody *body;
+    // Null for bodies whose transform can't be polled, those never sleep
+    EvPolledMotionState *motionState;
+  };
+
+  void trackRigidBody(btRigidBody *body);
+  void addLodBody(btRigidBody *body);
+  void removeLodBody(btRigidBody *body);
+  // Moves the proxy without rebuilding the static tree
+  bool moveToStaticSet(btDbvtBroadphase *dbvt, btCollisionObject *object);
+
+  btAlignedObjectArray<KinematicBody> kinematicBodies;
+  // Non-static objects that aren't rigid bodies, like ghosts
+  btAlignedObjectArray<btCollisionObject*> looseObjects;
+
+  btAlignedObjectArray<LodBody> lodBodies;
+  btAlignedObjectArray<HeldBody> heldBodies;
+  int lodInterval;
+  U64 lodTick;
+  U32 lodNextPhase;
+  bool lodPairsDirty;
+  bool staticsFrozen;
+};
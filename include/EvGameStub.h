@@ -0,0 +1,32 @@
+#pragma once
+
+#include <LinearMath/btTransform.h>
+#include <evol/common/ev_types.h>
+
+// Headless stand-in for the game module while a capture is replayed. It
+// answers which world a scene uses and hands motion states the game object
+// transforms the capture recorded. What the simulation writes back is
+// dropped, so reads always see the game's last recorded state, the same
+// state the capture compared against when it skipped unchanged transforms.
+class EvGameStub
+{
+public:
+  static inline bool isActive() {
+    return active;
+  }
+
+  // Turning the stub off forgets every scene and object
+  static void setActive(bool enable);
+
+  static void setSceneWorld(U64 scene, U64 world);
+  static U64 getSceneWorld(U64 scene);
+
+  // Objects the stub hasn't seen sit at the origin
+  static void getTransform(U64 scene, U64 object, btTransform &transform);
+  // Column-major copy of the same transform
+  static void getMatrix(U64 scene, U64 object, F32 *matrix);
+  static void setTransform(U64 scene, U64 object, const F32 *matrix);
+
+private:
+  static bool active;
+};
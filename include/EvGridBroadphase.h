@@ -0,0 +1,119 @@
+#pragma once
+
+#include <BulletCollision/BroadphaseCollision/btBroadphaseInterface.h>
+#include <BulletCollision/BroadphaseCollision/btOverlappingPairCache.h>
+#include <LinearMath/btAlignedObjectArray.h>
+#include <evol/common/ev_types.h>
+
+ATTRIBUTE_ALIGNED16(struct)
+EvGridProxy : public btBroadphaseProxy
+{
+  BT_DECLARE_ALIGNED_ALLOCATOR();
+
+  I32 index;
+
+  EvGridProxy(
+      const btVector3 &aabbMin,
+      const btVector3 &aabbMax,
+      void *userPtr,
+      int collisionFilterGroup,
+      int collisionFilterMask)
+    : btBroadphaseProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask)
+    , index(-1)
+  {}
+};
+
+// Uniform-grid (spatial hash) broadphase for small, densely packed scenes
+// where most proxies move every step. The grid is rebuilt from scratch in
+// `calculateOverlappingPairs`: proxies are binned by cell, the bins are
+// sorted and each pair is tested once, in the first cell both proxies share.
+// Proxies spanning too many cells, or reaching past the 2^20 cells the keys
+// can tell apart on each side of the origin, are kept in a separate list and
+// tested against everything.
+class EvGridBroadphase : public btBroadphaseInterface
+{
+private:
+  struct CellEntry {
+    U64 cell;
+    I32 proxy;
+
+    bool operator<(const CellEntry &other) const {
+      return cell < other.cell || (cell == other.cell && proxy < other.proxy);
+    }
+  };
+
+  btOverlappingPairCache *pairCache;
+  btScalar cellSize;
+  btScalar invCellSize;
+  I32 uidCounter;
+
+  btAlignedObjectArray<EvGridProxy*> proxies;
+  btAlignedObjectArray<CellEntry> cellEntries;
+  btAlignedObjectArray<I32> oversizedProxies;
+
+  btVector3 boundsMin;
+  btVector3 boundsMax;
+
+  // False if the proxy reaches outside the representable cell range
+  bool cellRange(
+      const btBroadphaseProxy *proxy,
+      I32 minCell[3],
+      I32 maxCell[3]) const;
+
+  void testPair(
+      EvGridProxy *proxy0,
+      EvGridProxy *proxy1);
+
+public:
+  EvGridBroadphase(
+      btScalar cellSize);
+  ~EvGridBroadphase() override;
+
+  btBroadphaseProxy *createProxy(
+      const btVector3 &aabbMin,
+      const btVector3 &aabbMax,
+      int shapeType,
+      void *userPtr,
+      int collisionFilterGroup,
+      int collisionFilterMask,
+      btDispatcher *dispatcher) override;
+  void destroyProxy(
+      btBroadphaseProxy *proxy,
+      btDispatcher *dispatcher) override;
+  void setAabb(
+      btBroadphaseProxy *proxy,
+      const btVector3 &aabbMin,
+      const btVector3 &aabbMax,
+      btDispatcher *dispatcher) override;
+  void getAabb(
+      btBroadphaseProxy *proxy,
+      btVector3 &aabbMin,
+      btVector3 &aabbMax) const override;
+
+  void rayTest(
+      const btVector3 &rayFrom,
+      const btVector3 &rayTo,
+      btBroadphaseRayCallback &rayCallback,
+      const btVector3 &aabbMin = btVector3(0, 0, 0),
+      const btVector3 &aabbMax = btVector3(0, 0, 0)) override;
+  void aabbTest(
+      const btVector3 &aabbMin,
+      const btVector3 &aabbMax,
+      btBroadphaseAabbCallback &callback) override;
+
+  void calculateOverlappingPairs(
+      btDispatcher *dispatcher) override;
+
+  btOverlappingPairCache *getOverlappingPairCache() override {
+    return pairCache;
+  }
+  const btOverlappingPairCache *getOverlappingPairCache() const override {
+    return pairCache;
+  }
+
+  void getBroadphaseAabb(
+      btVector3 &aabbMin,
+      btVector3 &aabbMax) const override;
+
+  void printStats() override;
+};
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <BulletCollision/CollisionShapes/btHeightfieldTerrainShape.h>
+#include <evol/common/ev_types.h>
+
+#define EV_HEIGHTMAP_MAGIC 0x4d485645u // "EVHM"
+#define EV_HEIGHTMAP_VERSION 1u
+
+typedef enum {
+  EV_HEIGHTMAP_U8,
+  EV_HEIGHTMAP_I16,
+  EV_HEIGHTMAP_F32,
+} EvHeightmapDataType;
+
+// Raw heightmap layout (.evhm). The samples follow the header directly as a
+// row-major `width * length` grid of `dataType` values.
+struct EvHeightmapHeader {
+  U32 magic;
+  U32 version;
+  U32 width;
+  U32 length;
+  U32 dataType;
+  F32 minHeight;
+  F32 maxHeight;
+  // Integer samples are multiplied by this to get heights
+  F32 heightScale;
+};
+
+// Heightfield over a read-only memory mapping of a heightmap file. Bullet
+// reads the samples straight out of the mapping, nothing is copied, and the
+// file stays mapped for the lifetime of the shape.
+ATTRIBUTE_ALIGNED16(class)
+EvHeightfieldShape : public btHeightfieldTerrainShape
+{
+private:
+  void *mappedData;
+  U64 mappedSize;
+  void *fileHandle;
+  void *mappingHandle;
+
+  EvHeightfieldShape(
+      const EvHeightmapHeader *header,
+      void *mappedData,
+      U64 mappedSize,
+      void *fileHandle,
+      void *mappingHandle);
+
+public:
+  ~EvHeightfieldShape() override;
+
+  // Returns nullptr if the file can't be mapped or isn't a valid heightmap
+  static EvHeightfieldShape *fromFile(
+      const char *path);
+};
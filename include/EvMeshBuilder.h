@@ -0,0 +1,102 @@
+#pragma once
+
+#include <BulletCollision/CollisionShapes/btEmptyShape.h>
+#include <BulletCollision/CollisionShapes/btTriangleMesh.h>
+#include <BulletCollision/CollisionShapes/btBvhTriangleMeshShape.h>
+#include <evol/common/ev_types.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct EvMeshBuildJob {
+  enum State {
+    QUEUED,
+    BUILDING,
+    DONE,
+    FAILED,
+  };
+
+  std::string path;
+  std::atomic<int> state;
+
+  // Owned by the job, freed with the last reference to it
+  btTriangleMesh *mesh;
+  btBvhTriangleMeshShape *shape;
+
+  EvMeshBuildJob(const char *path);
+  ~EvMeshBuildJob();
+};
+
+// Stand-in for a triangle mesh that is still being built. Objects can be
+// created against it; they stay out of the world until `isReady` and are
+// then switched over to `getShape`. Destroying the placeholder frees the
+// built mesh as well, even if the build is still running.
+ATTRIBUTE_ALIGNED16(class)
+EvPendingMeshShape : public btEmptyShape
+{
+private:
+  std::shared_ptr<EvMeshBuildJob> job;
+
+public:
+  EvPendingMeshShape(
+      std::shared_ptr<EvMeshBuildJob> job);
+
+  // True once the build has finished, successfully or not
+  bool isReady() const;
+
+  // The built mesh, nullptr if it isn't ready or failed to build
+  btCollisionShape *getShape() const;
+
+  const char *getPath() const;
+};
+
+// Pool of threads that build the BVHs of mesh assets. The asset itself is
+// loaded by the thread making the request, the asset manager isn't known to
+// be safe to call from other threads; only the BVH build, which is the bulk
+// of the work for large meshes, runs on the pool.
+//
+// Every queued job holds its loaded mesh, so the queue is bounded: once
+// MESH_BUILD_QUEUE_PER_THREAD jobs per thread are waiting, `request` blocks
+// before loading until a build thread takes one of them.
+class EvMeshBuilder
+{
+public:
+  // Fills `mesh` from the asset at `path`, runs on the requesting thread
+  typedef bool (*LoadFunc)(const char *path, btTriangleMesh *mesh);
+
+  EvMeshBuilder(
+      LoadFunc load,
+      U32 maxConcurrentBuilds);
+
+  // Finishes the builds in progress, queued ones are marked failed
+  ~EvMeshBuilder();
+
+  // Loads the mesh synchronously, may first wait for a queue slot
+  EvPendingMeshShape *request(
+      const char *path);
+
+  // Grows or shrinks the pool, queued builds are kept. Threads leaving the
+  // pool finish their current build first.
+  void setMaxConcurrentBuilds(U32 count);
+
+private:
+  void work(U32 index);
+
+  LoadFunc load;
+  U32 threadCount;
+  std::vector<std::thread> threads;
+  std::deque<std::shared_ptr<EvMeshBuildJob>> queue;
+  std::mutex queueMtx;
+  std::condition_variable queueCond;
+  // Signalled when a job leaves the queue
+  std::condition_variable slotCond;
+  // Queued jobs plus requests loading into a reserved slot
+  U32 outstanding;
+  bool stopping;
+};
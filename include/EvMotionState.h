@@ -3,6 +3,8 @@
 #include <btBulletDynamicsCommon.h>
 #include <evol/common/ev_types.h>
 
+#include <EvDynamicsWorld.h>
+
 #define TYPE_MODULE evmod_game
 #define NAMESPACE_MODULE evmod_game
 #include <evol/meta/type_import.h>
@@ -18,7 +20,10 @@ class GameModuleRef
     GameModuleRef() {
       if(refcount++ == 0) {
         game_module = evol_loadmodule_weak("game");
-        IMPORT_NAMESPACE(Object, game_module);
+        // Absent in headless replays, where EvGameStub answers instead
+        if(game_module) {
+          IMPORT_NAMESPACE(Object, game_module);
+        }
       }
     }
 
@@ -27,13 +32,17 @@ class GameModuleRef
 };
 
 ATTRIBUTE_ALIGNED16(struct)
-EvMotionState : public btMotionState
+EvMotionState : public EvPolledMotionState
 {
 private:
   GameScene gameScene;
   GameObject gameObject;
   GameModuleRef mod;
 
+  // The game object's matrix as of the last poll
+  F32 polledTransform[16];
+  bool polled;
+
 public:
   EvMotionState(
       btVector3* graphicsVec = nullptr,
@@ -43,8 +52,21 @@ public:
   void getWorldTransform(btTransform & centerOfMassWorldTrans) const override;
   void setWorldTransform(const btTransform & centerOfMassWorldTrans) override;
 
+  // Writes back the position only, leaving the game object's rotation alone
+  void setWorldPosition(const btVector3 & position);
+
+  // Compares the game object's matrix with the last polled one and only
+  // converts it when it changed. The first poll, and the first one after
+  // `invalidateWorldTransform`, always reports a change.
+  bool pollWorldTransform(btTransform & centerOfMassWorldTrans) override;
+
+  inline void invalidateWorldTransform() {
+    polled = false;
+  }
+
   inline void setGameObject(GameObject id) {
     gameObject = id;
+    polled = false;
   };
 
   inline void setGameScene(GameScene gameSceneHandle) {
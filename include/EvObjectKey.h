@@ -0,0 +1,22 @@
+#pragma once
+
+#include <evol/common/ev_types.h>
+
+#include <functional>
+
+// Identifies a game object across scenes, for maps keyed by the objects
+// the capture and the replay stub track transforms of
+struct EvObjectKey {
+  U64 scene;
+  U64 object;
+
+  bool operator==(const EvObjectKey &other) const {
+    return scene == other.scene && object == other.object;
+  }
+};
+
+struct EvObjectKeyHash {
+  size_t operator()(const EvObjectKey &key) const {
+    return std::hash<U64>()(key.scene * 0x9E3779B97F4A7C15ull ^ key.object);
+  }
+};
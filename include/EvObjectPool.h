@@ -0,0 +1,108 @@
+#pragma once
+
+#include <LinearMath/btAlignedAllocator.h>
+#include <LinearMath/btAlignedObjectArray.h>
+
+#include <new>
+#include <utility>
+
+// Chunked free-list pool. Objects are constructed in place on `acquire` and
+// destructed on `release`; the chunks themselves are only returned to the
+// heap when the pool is destroyed. Not thread-safe, callers are expected to
+// hold the owning world's lock.
+template<typename T, int ChunkSize = 256>
+class EvObjectPool
+{
+  private:
+    union Slot {
+      Slot *next;
+      alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    btAlignedObjectArray<Slot*> chunks;
+    Slot *freeList;
+    int liveCount;
+
+    void grow()
+    {
+      Slot *chunk = static_cast<Slot*>(btAlignedAlloc(sizeof(Slot) * ChunkSize, alignof(Slot) > 16 ? alignof(Slot) : 16));
+      for(int i = ChunkSize - 1; i >= 0; --i) {
+        chunk[i].next = freeList;
+        freeList = &chunk[i];
+      }
+      chunks.push_back(chunk);
+    }
+
+  public:
+    EvObjectPool()
+      : freeList(nullptr)
+      , liveCount(0)
+    {}
+
+    EvObjectPool(const EvObjectPool&) = delete;
+    EvObjectPool& operator=(const EvObjectPool&) = delete;
+
+    ~EvObjectPool()
+    {
+      for(int i = 0; i < chunks.size(); ++i) {
+        btAlignedFree(chunks[i]);
+      }
+    }
+
+    template<typename... Args>
+    T* acquire(Args&&... args)
+    {
+      if(freeList == nullptr) {
+        grow();
+      }
+      Slot *slot = freeList;
+      freeList = slot->next;
+      ++liveCount;
+      return new (slot->storage) T(std::forward<Args>(args)...);
+    }
+
+    void release(T *object)
+    {
+      object->~T();
+      Slot *slot = reinterpret_cast<Slot*>(object);
+      slot->next = freeList;
+      freeList = slot;
+      --liveCount;
+    }
+
+    // Destructs all objects first, then splices their slots into the free
+    // list in one go.
+    void releaseBatch(T **objects, int count)
+    {
+      Slot *head = nullptr;
+      Slot *tail = nullptr;
+      int released = 0;
+      for(int i = 0; i < count; ++i) {
+        if(objects[i] == nullptr) {
+          continue;
+        }
+        objects[i]->~T();
+        Slot *slot = reinterpret_cast<Slot*>(objects[i]);
+        slot->next = head;
+        head = slot;
+        if(tail == nullptr) {
+          tail = slot;
+        }
+        ++released;
+      }
+
+      if(head != nullptr) {
+        tail->next = freeList;
+        freeList = head;
+        liveCount -= released;
+      }
+    }
+
+    inline int size() const {
+      return liveCount;
+    }
+
+    inline int capacity() const {
+      return chunks.size() * ChunkSize;
+    }
+};
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <evol/common/ev_types.h>
+
+#include <unordered_map>
+
+// Re-runs a capture against the module with EvGameStub standing in for the
+// game, so a recorded session can be stepped and profiled without the rest
+// of the engine. Handles the capture recorded are mapped to the ones the
+// replay creates; calls on objects that existed before the capture started
+// can't be mapped and are skipped.
+class EvReplay
+{
+public:
+  struct Stats {
+    U32 recordCount;
+    U32 skippedCount;
+    U32 stepCount;
+    F32 totalStepTimeMs;
+    F32 worstStepTimeMs;
+  };
+
+  // Fails if the capture can't be opened. Worlds the capture left alive are
+  // destroyed at the end.
+  bool run(const char *path, Stats &stats);
+
+private:
+  U64 world(U64 recorded) const;
+  void *object(void *recorded) const;
+
+  std::unordered_map<U64, U64> worlds;
+  std::unordered_map<void*, void*> objects;
+};
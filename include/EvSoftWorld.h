@@ -0,0 +1,178 @@
+#pragma once
+
+#include <btBulletDynamicsCommon.h>
+#include <BulletSoftBody/btSoftBody.h>
+#include <BulletSoftBody/btSoftRigidDynamicsWorld.h>
+#include <BulletSoftBody/btSoftBodyRigidBodyCollisionConfiguration.h>
+#include <BulletSoftBody/btDefaultSoftBodySolver.h>
+#include <evol/common/ev_types.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// Runs the per-body passes of Bullet's default soft body solver on its own
+// helper threads, together with the thread stepping the soft world. Bullet's
+// task scheduler is left to the rigid step: sharing it would make either
+// step fall back to running serially whenever the other holds it.
+// Soft bodies only collide with static mirrors, which take no impulses, so
+// bodies never write to each other's state.
+class EvSoftBodySolver : public btDefaultSoftBodySolver
+{
+public:
+  enum Pass {
+    PREDICT_MOTION,
+    SOLVE_CONSTRAINTS,
+    INTEGRATE_MOTION,
+  };
+
+  EvSoftBodySolver(
+      U32 helperCount);
+
+  ~EvSoftBodySolver();
+
+  void predictMotion(btScalar solverdt) override;
+  void solveConstraints(btScalar solverdt) override;
+  void updateSoftBodies() override;
+
+private:
+  void run(Pass pass, btScalar timeStep);
+  void runBodies();
+  void work();
+
+  std::vector<std::thread> helpers;
+  std::mutex passMtx;
+  std::condition_variable startCond;
+  std::condition_variable doneCond;
+  U64 generation;
+  U32 busyHelpers;
+  bool stopping;
+
+  // The pass in flight, bodies are handed out one at a time
+  Pass pass;
+  btScalar timeStep;
+  std::atomic<int> nextBody;
+};
+
+// Soft bodies of one physics world, simulated in their own
+// btSoftRigidDynamicsWorld on a dedicated thread. A step is started from the
+// physics world's progress and runs alongside the rigid step; the next
+// progress call, or anything that changes the soft world, waits for it.
+//
+// Cloth collides with mirrors of the physics world's static objects, which
+// share the statics' shapes. Dynamic bodies aren't mirrored, but vertices can
+// be pinned to them and follow them from one step to the next.
+class EvSoftWorld
+{
+public:
+  struct ClothParams {
+    btScalar mass;
+    btScalar stiffness;
+    btScalar bendingStiffness;
+    btScalar damping;
+    btScalar friction;
+    int iterations;
+  };
+
+  struct Pin {
+    int node;
+    btScalar mass;
+    // Null pins the node in place, `offset` is then in world space
+    const btCollisionObject *object;
+    btVector3 offset;
+  };
+
+  // Mesh vertices sharing a position are welded into one node. The
+  // positions are kept in the mesh's vertex order, so the renderer can use
+  // them with the mesh's own index buffer.
+  struct Cloth {
+    EvSoftWorld *owner;
+    btSoftBody *body;
+    std::vector<int> vertexNodes;
+    btAlignedObjectArray<Pin> pins;
+
+    // As of the last finished step
+    std::vector<F32> positions;
+  };
+
+  EvSoftWorld(
+      const btVector3 &gravity);
+
+  EvSoftWorld(const EvSoftWorld&) = delete;
+  EvSoftWorld& operator=(const EvSoftWorld&) = delete;
+
+  ~EvSoftWorld();
+
+  void setGravity(const btVector3 &gravity);
+
+  // Static objects are mirrored into the soft world with their shape and
+  // transform; `updateStatic` follows a moved static
+  void addStatic(const btCollisionObject *object);
+  void updateStatic(const btCollisionObject *object);
+
+  // Drops the object's mirror. Vertices pinned to it stay where they are.
+  void forgetObject(const btCollisionObject *object);
+
+  Cloth *newCloth(
+      const btVector3 *vertices,
+      U32 vertexCount,
+      const U32 *indices,
+      U32 indexCount,
+      const btTransform &transform,
+      const ClothParams &params);
+
+  void destroyCloth(Cloth *cloth);
+
+  // A pinned vertex has no mass. With an object it keeps its offset to it,
+  // otherwise it stays where it is when pinned.
+  void pinVertex(Cloth *cloth, U32 vertex, const btCollisionObject *object);
+  void unpinVertex(Cloth *cloth, U32 vertex);
+
+  // Copies up to `maxVertices` xyz positions, returns the number copied
+  static U32 readVertices(
+      const Cloth *cloth,
+      F32 *out_positions,
+      U32 maxVertices);
+
+  // Waits for the previous step, moves pinned vertices to their objects
+  // and starts the next step
+  void stepAsync(
+      btScalar timeStep,
+      int maxSubSteps,
+      btScalar fixedTimeStep);
+
+  void wait();
+
+  inline int getNumCloths() const {
+    return cloths.size();
+  }
+
+private:
+  void work();
+  void updatePins();
+  void publish(Cloth *cloth);
+
+  btSoftBodyRigidBodyCollisionConfiguration *collisionConfiguration;
+  btCollisionDispatcher *dispatcher;
+  btBroadphaseInterface *broadphase;
+  btSequentialImpulseConstraintSolver *constraintSolver;
+  EvSoftBodySolver *softBodySolver;
+  btSoftRigidDynamicsWorld *world;
+
+  std::unordered_map<const btCollisionObject*, btCollisionObject*> mirrors;
+  btAlignedObjectArray<Cloth*> cloths;
+
+  std::thread thread;
+  std::mutex stepMtx;
+  std::condition_variable stepCond;
+  bool stepping;
+  bool stopping;
+  btScalar timeStep;
+  int maxSubSteps;
+  btScalar fixedTimeStep;
+
+  std::mutex publishMtx;
+};
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <BulletCollision/CollisionDispatch/btCollisionObject.h>
+#include <LinearMath/btAlignedObjectArray.h>
+#include <evol/common/ev_types.h>
+
+// Hashes the simulated state of a set of collision objects. The objects'
+// entity, transform and velocities are first gathered into a contiguous
+// array of fixed-size records, sorted by entity so the hash doesn't depend on
+// the order the objects are given in, then hashed in one linear pass with
+// four independent 32-bit lanes (xxHash32's inner loop) so the compiler can
+// keep all lanes in one SIMD register.
+//
+// Activation state is left out: LOD tiers and kinematic sleep force it from
+// local decisions, like the anchors a machine streams around.
+//
+// With a quantum above zero every value is rounded to a multiple of it
+// before hashing, so states that only differ below that precision hash the
+// same. A zero quantum hashes the exact bits.
+class EvStateHasher
+{
+public:
+  struct Region {
+    I32 x;
+    I32 z;
+    U64 hash;
+  };
+
+  // Identifies an object across machines
+  typedef U64 (*EntityFunc)(const btCollisionObject *object);
+
+  U64 hash(
+      const btCollisionObject * const *objects,
+      EntityFunc entityOf,
+      int count,
+      F32 quantum);
+
+  // Splits the XZ plane into square regions and hashes the objects of each
+  // region separately, so two states can be compared region by region.
+  // Regions are returned sorted by (x, z); at most `maxRegions` are written,
+  // the return value is the number of regions that have objects.
+  U32 hashRegions(
+      const btCollisionObject * const *objects,
+      EntityFunc entityOf,
+      int count,
+      F32 quantum,
+      F32 regionSize,
+      Region *out_regions,
+      U32 maxRegions);
+
+private:
+  struct Record {
+    U32 words[16];
+  };
+
+  struct RegionRecord {
+    U64 key;
+    U64 hash;
+  };
+
+  void gather(
+      const btCollisionObject * const *objects,
+      EntityFunc entityOf,
+      int count,
+      F32 quantum);
+
+  static U64 hashRecords(const Record *records, int count);
+
+  btAlignedObjectArray<Record> records;
+  btAlignedObjectArray<RegionRecord> regionRecords;
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <btBulletDynamicsCommon.h>
+#include <BulletCollision/BroadphaseCollision/btDbvt.h>
+#include <evol/common/ev_types.h>
+
+// Serves a vehicle the suspension rays EvVehicleBatch cast for it ahead of
+// its update. A ray that doesn't match the cached one, which only happens if
+// the vehicle moved in between, is cast against the world instead.
+class EvVehicleRaycaster : public btVehicleRaycaster
+{
+public:
+  struct Hit {
+    btVector3 from;
+    btVector3 to;
+    // Null if the ray hit nothing. Statics are plain collision objects.
+    const btCollisionObject *object;
+    btVehicleRaycasterResult result;
+  };
+
+  EvVehicleRaycaster();
+
+  BT_DECLARE_ALIGNED_ALLOCATOR();
+
+  void *castRay(
+      const btVector3 &from,
+      const btVector3 &to,
+      btVehicleRaycasterResult &result) override;
+
+  btRaycastVehicle *vehicle;
+  btCollisionWorld *world;
+  btAlignedObjectArray<Hit> hits;
+  int cursor;
+
+  // Objects whose AABB touches the vehicle's rays
+  btAlignedObjectArray<const btCollisionObject*> candidates;
+  btDbvtAabbMm bounds;
+};
+
+// Updates every raycast vehicle of a world as a single action. The
+// suspension rays of all vehicles are cast in one batch before any vehicle is
+// updated: the vehicles' ray bounds are put in a tree that is traversed
+// against the broadphase once, then each vehicle tests its rays against the
+// objects found for it on Bullet's task scheduler.
+class EvVehicleBatch : public btActionInterface
+{
+public:
+  EvVehicleBatch();
+  ~EvVehicleBatch();
+
+  // The chassis must be a dynamic rigidbody
+  btRaycastVehicle *addVehicle(
+      const btRaycastVehicle::btVehicleTuning &tuning,
+      btRigidBody *chassis);
+
+  void removeVehicle(btRaycastVehicle *vehicle);
+
+  inline int getNumVehicles() const {
+    return vehicles.size();
+  }
+
+  void updateAction(btCollisionWorld *world, btScalar timeStep) override;
+  void debugDraw(btIDebugDraw *debugDrawer) override;
+
+private:
+  void gatherCandidates(btCollisionWorld *world);
+
+  // Each vehicle's raycaster owns the vehicle
+  btAlignedObjectArray<EvVehicleRaycaster*> vehicles;
+  // Vehicles that take part in the current update
+  btAlignedObjectArray<EvVehicleRaycaster*> active;
+  btDbvt queries;
+};
@@ -17,6 +17,31 @@ _ev_physics_init();
 I32 
 _ev_physics_deinit();
 
+void
+_ev_physics_setworkerthreads(
+    U32 count);
+
+// Mesh BVHs built at the same time for newMeshAsync
+void
+_ev_physics_setmaxmeshbuilds(
+    U32 count);
+
+// Streams every call that changes physics state, plus ray tests, to a
+// binary log. A null path uses the default capture file.
+bool
+_ev_physics_startcapture(
+    CONST_STR path);
+
+void
+_ev_physics_stopcapture();
+
+// Re-runs a capture headless, with a stub in place of the game module.
+// Refused while any physics world exists, the stub stands in for the game
+// in every world.
+PhysicsReplayStats
+_ev_physics_replay(
+    CONST_STR path);
+
 U32 
 _ev_physics_update(
     F32 deltaTime);
@@ -26,6 +51,56 @@ _ev_collisionshape_newmesh(
     PhysicsWorldHandle world_handle,
     CONST_STR mesh_path);
 
+CollisionShapeHandle
+_ev_collisionshape_newconvexhull(
+    PhysicsWorldHandle world_handle,
+    CONST_STR mesh_path,
+    U32 maxVertices);
+
+CollisionShapeHandle
+_ev_collisionshape_newcompound(
+    PhysicsWorldHandle world_handle,
+    CollisionShapeHandle *children,
+    Matrix4x4 *transforms,
+    U32 childCount);
+
+CollisionShapeHandle
+_ev_collisionshape_newdecomposedmesh(
+    PhysicsWorldHandle world_handle,
+    CONST_STR mesh_path,
+    U32 maxHulls,
+    U32 maxVerticesPerHull);
+
+CollisionShapeHandle
+_ev_collisionshape_newheightfield(
+    PhysicsWorldHandle world_handle,
+    CONST_STR heightmap_path,
+    Vec3 scale);
+
+// Refused with a warning while any object or compound of the world still
+// uses the shape; destroy those first
+void
+_ev_collisionshape_destroy(
+    PhysicsWorldHandle world_handle,
+    CollisionShapeHandle shape);
+
+void
+_ev_collisionshape_setcachedirectory(
+    CONST_STR path);
+
+// Triangle mesh whose BVH is built in the background. The asset is loaded
+// synchronously by the calling thread, which also blocks while the build
+// queue is full. The handle can be used right away; objects created with it
+// join the world once the mesh is ready.
+CollisionShapeHandle
+_ev_collisionshape_newmeshasync(
+    PhysicsWorldHandle world_handle,
+    CONST_STR mesh_path);
+
+bool
+_ev_collisionshape_isready(
+    CollisionShapeHandle shape);
+
 CollisionShapeHandle 
 _ev_collisionshape_newcapsule(
     PhysicsWorldHandle world_handle,
@@ -81,6 +156,143 @@ _ev_rigidbody_destroy(
   GameScene game_scene,
   RigidbodyHandle rb);
 
+void
+_ev_rigidbody_destroybatch(
+  GameScene game_scene,
+  RigidbodyHandle *rbs,
+  U32 count);
+
+// The shape must be convex, returns nullptr otherwise
+CharacterHandle
+_ev_character_new(
+    GameScene game_scene,
+    U64 entt,
+    CharacterInfo info);
+
+void
+_ev_character_destroy(
+    GameScene game_scene,
+    CharacterHandle character);
+
+void
+_ev_character_move(
+    CharacterHandle character,
+    Vec3 desiredMove,
+    F32 deltaTime);
+
+void
+_ev_character_movebatch(
+    CharacterHandle *characters,
+    Vec3 *desiredMoves,
+    U32 count,
+    F32 deltaTime);
+
+void
+_ev_character_jump(
+    CharacterHandle character);
+
+bool
+_ev_character_isonground(
+    CharacterHandle character);
+
+// Vehicles are destroyed along with their chassis. The suspension rays of
+// all vehicles in a world are cast in one batch every internal step.
+VehicleHandle
+_ev_vehicle_new(
+    GameScene game_scene,
+    RigidbodyHandle chassis,
+    VehicleInfo info,
+    VehicleWheel *wheels,
+    U32 wheelCount);
+
+void
+_ev_vehicle_destroy(
+    GameScene game_scene,
+    VehicleHandle vehicle);
+
+void
+_ev_vehicle_setcontrols(
+    VehicleHandle vehicle,
+    VehicleControls controls);
+
+void
+_ev_vehicle_setcontrolsbatch(
+    VehicleHandle *vehicles,
+    VehicleControls *controls,
+    U32 count);
+
+// Along the chassis' forward axis, in m/s
+F32
+_ev_vehicle_getspeed(
+    VehicleHandle vehicle);
+
+U32
+_ev_vehicle_getwheeltransforms(
+    VehicleHandle vehicle,
+    Matrix4x4 *out_transforms,
+    U32 maxWheels);
+
+// Constraints attached to a rigidbody are destroyed along with it
+ConstraintHandle
+_ev_constraint_new(
+    PhysicsWorldHandle world_handle,
+    ConstraintInfo info);
+
+void
+_ev_constraint_newbatch(
+    PhysicsWorldHandle world_handle,
+    ConstraintInfo *infos,
+    U32 count,
+    ConstraintHandle *out_constraints);
+
+void
+_ev_constraint_destroy(
+    PhysicsWorldHandle world_handle,
+    ConstraintHandle constraint);
+
+void
+_ev_constraint_setenabled(
+    ConstraintHandle constraint,
+    bool enabled);
+
+// Cloth from a mesh asset. The soft world steps on its own thread alongside
+// the rigid step, so positions lag the rigid bodies by one progress call.
+SoftBodyHandle
+_ev_softbody_newcloth(
+    PhysicsWorldHandle world_handle,
+    CONST_STR mesh_path,
+    SoftBodyInfo info);
+
+void
+_ev_softbody_destroy(
+    PhysicsWorldHandle world_handle,
+    SoftBodyHandle softbody);
+
+// A NULL rigidbody pins the vertex where it is
+void
+_ev_softbody_pinvertex(
+    PhysicsWorldHandle world_handle,
+    SoftBodyHandle softbody,
+    U32 vertex,
+    RigidbodyHandle rigidbody);
+
+void
+_ev_softbody_unpinvertex(
+    PhysicsWorldHandle world_handle,
+    SoftBodyHandle softbody,
+    U32 vertex);
+
+U32
+_ev_softbody_getvertexcount(
+    SoftBodyHandle softbody);
+
+// Positions in the mesh's vertex order, xyz per vertex
+U32
+_ev_softbody_getvertices(
+    SoftBodyHandle softbody,
+    F32 *out_positions,
+    U32 maxVertices);
+
 void
 _ev_physics_dispatch_collisionenter(
     U64 game_scene,
@@ -100,6 +312,108 @@ _ev_physics_enablevisualization(
 PhysicsWorldHandle
 ev_physicsworld_newworld();
 
+PhysicsWorldHandle
+ev_physicsworld_newworldex(
+    PhysicsWorldInfo info);
+
+PhysicsWorldInfo
+ev_physicsworld_getdefaultinfo();
+
+void
+ev_physicsworld_freezestatics(
+    PhysicsWorldHandle world_handle);
+
+// Anchors are the points of interest (players, cameras) the world streams
+// around. With a streaming radius set, bodies further than that from every
+// anchor are parked outside the world until an anchor comes near again.
+U32
+ev_physicsworld_addanchor(
+    PhysicsWorldHandle world_handle,
+    Vec3 position);
+
+void
+ev_physicsworld_setanchorposition(
+    PhysicsWorldHandle world_handle,
+    U32 anchor,
+    Vec3 position);
+
+void
+ev_physicsworld_removeanchor(
+    PhysicsWorldHandle world_handle,
+    U32 anchor);
+
+void
+ev_physicsworld_setstreamingradius(
+    PhysicsWorldHandle world_handle,
+    F32 radius);
+
+// Simulation LOD around the same anchors. Dynamic bodies further than
+// `reducedDistance` from every anchor are stepped once every `reducedInterval`
+// ticks and skip the narrowphase against each other; past `ballisticDistance`
+// they only collide with static geometry. A zero distance disables that tier.
+void
+ev_physicsworld_setloddistances(
+    PhysicsWorldHandle world_handle,
+    F32 reducedDistance,
+    F32 ballisticDistance,
+    U32 reducedInterval);
+
+// After every progress call that steps the world, touching pairs whose total
+// impulse reaches `minImpulse` are written to a report of at most `capacity`
+// entries. Calls that don't reach a full substep leave the report empty. A
+// zero capacity turns the report off.
+void
+ev_physicsworld_setcontactreport(
+    PhysicsWorldHandle world_handle,
+    U32 capacity,
+    F32 minImpulse);
+
+// Copies at most `maxContacts` entries of the report, returns the number of
+// entries the report holds
+U32
+ev_physicsworld_getcontacts(
+    PhysicsWorldHandle world_handle,
+    ContactPoint *out_contacts,
+    U32 maxContacts);
+
+// In deterministic mode every progress call advances exactly one tick of the
+// world's fixed timestep, solver randomization is off and objects are kept
+// in entity order: existing ones are re-added when the mode is turned on,
+// new ones join at the start of the next tick.
+void
+ev_physicsworld_setdeterministic(
+    PhysicsWorldHandle world_handle,
+    bool deterministic);
+
+// Ticks stepped in deterministic mode
+U64
+ev_physicsworld_gettick(
+    PhysicsWorldHandle world_handle);
+
+// Hash of every object's entity, transform and velocities, dormant objects
+// included. Equal hashes on two machines at the same tick mean the
+// simulations agree, whatever order the objects were added in. A non-zero
+// `quantum` rounds values to multiples of it first, so differences below
+// that precision are ignored.
+U64
+ev_physicsworld_hashstate(
+    PhysicsWorldHandle world_handle,
+    F32 quantum);
+
+// Same state hashed per square region of the XZ plane, sorted by region.
+// Writes at most `maxRegions` and returns the number of occupied regions.
+U32
+ev_physicsworld_hashregions(
+    PhysicsWorldHandle world_handle,
+    F32 quantum,
+    F32 regionSize,
+    RegionHash *out_regions,
+    U32 maxRegions);
+
+PhysicsWorldStats
+ev_physicsworld_getstats(
+    PhysicsWorldHandle world_handle);
+
 void
 ev_physicsworld_destroyworld(
     PhysicsWorldHandle world_handle);
@@ -109,6 +423,23 @@ ev_physicsworld_progress(
     PhysicsWorldHandle world_handle,
     F32 deltaTime);
 
+void
+ev_physicsworld_setsubsteps(
+    PhysicsWorldHandle world_handle,
+    U32 maxSubSteps,
+    F32 fixedTimeStep);
+
+// Gravity and contact solver settings, applied from the next step. The
+// solver type itself is fixed when the world is created.
+void
+ev_physicsworld_setsolverparams(
+    PhysicsWorldHandle world_handle,
+    PhysicsSolverParams params);
+
+PhysicsSolverParams
+ev_physicsworld_getsolverparams(
+    PhysicsWorldHandle world_handle);
+
 PhysicsWorldHandle
 ev_physicsworld_invalidhandle();
 
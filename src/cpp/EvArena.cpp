@@ -0,0 +1,216 @@
+#include <EvArena.h>
+
+#include <LinearMath/btAlignedAllocator.h>
+#include <evol/common/ev_log.h>
+
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+// Arenas that can own blocks at the same time. Any further one runs with no
+// capacity and sends everything to the heap.
+#define MAX_LIVE_ARENAS 32
+
+// Sits in front of every block handed out by an arena. Heap blocks come
+// straight from malloc, without one.
+struct alignas(16) BlockHeader {
+  U32 sizeClass;
+};
+
+static thread_local EvArena *currentArena = nullptr;
+
+// Looked up on every free. A slot is cleared before its arena's memory goes
+// back to the heap, and that waits for the lookups in flight, so a lookup
+// never matches a heap block against memory an arena just gave up.
+static std::atomic<EvArena*> liveArenas[MAX_LIVE_ARENAS];
+static std::atomic<U32> liveArenaCount(0);
+static std::atomic<U32> ownerLookups(0);
+static std::atomic<bool> hookInstalled(false);
+
+EvArena::EvArena(
+    size_t capacity)
+  : capacity(capacity)
+  , offset(0)
+  , slot(-1)
+  , liveBlocks(0)
+  , released(false)
+  , overflowCount(0)
+{
+  memory = static_cast<unsigned char*>(malloc(capacity));
+  memset(freeLists, 0, sizeof(freeLists));
+
+  for(I32 i = 0; i < MAX_LIVE_ARENAS; i++) {
+    EvArena *expected = nullptr;
+    if(liveArenas[i].compare_exchange_strong(expected, this)) {
+      slot = i;
+      liveArenaCount++;
+      break;
+    }
+  }
+  if(slot < 0) {
+    ev_log_warn("More than %d physics arenas alive, the new one uses the heap", MAX_LIVE_ARENAS);
+    free(memory);
+    memory = nullptr;
+    this->capacity = 0;
+  }
+}
+
+EvArena::~EvArena()
+{
+  if(slot >= 0) {
+    liveArenas[slot].store(nullptr);
+    liveArenaCount--;
+    while(ownerLookups.load() > 0) {
+      std::this_thread::yield();
+    }
+  }
+  free(memory);
+}
+
+void
+EvArena::release()
+{
+  bool unused;
+  {
+    std::lock_guard<std::mutex> guard(mtx);
+    released = true;
+    unused = liveBlocks == 0;
+  }
+  if(unused) {
+    delete this;
+  }
+}
+
+void *
+EvArena::allocate(
+    size_t size)
+{
+  size_t total = size + sizeof(BlockHeader);
+  U32 sizeClass = MIN_SIZE_CLASS;
+  while(sizeClass <= MAX_SIZE_CLASS && (size_t(1) << sizeClass) < total) {
+    sizeClass++;
+  }
+  if(sizeClass > MAX_SIZE_CLASS) {
+    overflowCount++;
+    return nullptr;
+  }
+
+  std::lock_guard<std::mutex> guard(mtx);
+  void *block = freeLists[sizeClass];
+  if(block != nullptr) {
+    freeLists[sizeClass] = freeLists[sizeClass]->next;
+  } else if(offset + (size_t(1) << sizeClass) <= capacity) {
+    block = memory + offset;
+    offset += size_t(1) << sizeClass;
+  } else {
+    overflowCount++;
+    return nullptr;
+  }
+  liveBlocks++;
+
+  BlockHeader *header = static_cast<BlockHeader*>(block);
+  header->sizeClass = sizeClass;
+  return header + 1;
+}
+
+void
+EvArena::deallocate(
+    void *block,
+    U32 sizeClass)
+{
+  bool unused;
+  {
+    std::lock_guard<std::mutex> guard(mtx);
+    FreeBlock *freeBlock = static_cast<FreeBlock*>(block);
+    freeBlock->next = freeLists[sizeClass];
+    freeLists[sizeClass] = freeBlock;
+    liveBlocks--;
+    unused = released && liveBlocks == 0;
+  }
+  if(unused) {
+    delete this;
+  }
+}
+
+EvArena *
+EvArena::findOwner(
+    void *memblock)
+{
+  if(liveArenaCount.load() == 0) {
+    return nullptr;
+  }
+
+  EvArena *owner = nullptr;
+  ownerLookups++;
+  for(I32 i = 0; i < MAX_LIVE_ARENAS && owner == nullptr; i++) {
+    EvArena *arena = liveArenas[i].load();
+    if(arena != nullptr &&
+       memblock >= arena->memory && memblock < arena->memory + arena->capacity) {
+      owner = arena;
+    }
+  }
+  ownerLookups--;
+  return owner;
+}
+
+void *
+EvArena::allocFunc(
+    size_t size)
+{
+  EvArena *arena = currentArena;
+  if(arena != nullptr) {
+    void *block = arena->allocate(size);
+    if(block != nullptr) {
+      return block;
+    }
+  }
+
+  return malloc(size);
+}
+
+void
+EvArena::freeFunc(
+    void *memblock)
+{
+  if(memblock == nullptr) {
+    return;
+  }
+
+  // The owner can't go away underneath, it holds this block
+  EvArena *owner = findOwner(memblock);
+  if(owner != nullptr) {
+    BlockHeader *header = static_cast<BlockHeader*>(memblock) - 1;
+    owner->deallocate(header, header->sizeClass);
+  } else {
+    free(memblock);
+  }
+}
+
+void
+EvArena::install()
+{
+  if(!hookInstalled.exchange(true)) {
+    btAlignedAllocSetCustom(allocFunc, freeFunc);
+  }
+}
+
+void
+EvArena::uninstall()
+{
+  if(liveArenaCount.load() > 0) {
+    ev_log_warn("Physics arena blocks are still in use, the allocation hook stays installed");
+    return;
+  }
+  if(hookInstalled.exchange(false)) {
+    btAlignedAllocSetCustom(nullptr, nullptr);
+  }
+}
+
+EvArena *
+EvArena::setCurrent(
+    EvArena *arena)
+{
+  EvArena *previous = currentArena;
+  currentArena = arena;
+  return previous;
+}
@@ -0,0 +1,207 @@
+#include <EvCapture.h>
+#include <EvObjectKey.h>
+
+#include <mutex>
+#include <unordered_map>
+
+// Bytes buffered before they are written out
+#define CAPTURE_BUFFER_SIZE (256 * 1024)
+
+static struct {
+  std::mutex mtx;
+  FILE *file = nullptr;
+  std::vector<U8> buffer;
+
+  std::unordered_map<U64, U64> sceneWorlds;
+  std::unordered_map<EvObjectKey, EvCaptureMatrix, EvObjectKeyHash> transforms;
+} Capture;
+
+std::atomic<bool> EvCapture::active(false);
+
+bool
+EvCapture::start(
+    const char *path)
+{
+  std::lock_guard<std::mutex> guard(Capture.mtx);
+  if(Capture.file != nullptr) {
+    return false;
+  }
+
+  Capture.file = fopen(path, "wb");
+  if(Capture.file == nullptr) {
+    return false;
+  }
+
+  FileHeader header;
+  header.magic = MAGIC;
+  header.version = VERSION;
+  header.pointerSize = sizeof(void*);
+  fwrite(&header, sizeof(header), 1, Capture.file);
+
+  Capture.buffer.reserve(CAPTURE_BUFFER_SIZE);
+  Capture.sceneWorlds.clear();
+  Capture.transforms.clear();
+
+  active.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+void
+EvCapture::stop()
+{
+  active.store(false, std::memory_order_relaxed);
+
+  std::lock_guard<std::mutex> guard(Capture.mtx);
+  if(Capture.file == nullptr) {
+    return;
+  }
+
+  flush();
+  fclose(Capture.file);
+  Capture.file = nullptr;
+
+  Capture.sceneWorlds.clear();
+  Capture.transforms.clear();
+}
+
+// Called with the capture locked
+void
+EvCapture::flush()
+{
+  if(Capture.buffer.size() > 0) {
+    fwrite(&Capture.buffer[0], 1, Capture.buffer.size(), Capture.file);
+    Capture.buffer.clear();
+  }
+}
+
+void
+EvCapture::append(
+    EvCaptureOp op,
+    const std::vector<U8> &payload)
+{
+  RecordHeader header;
+  header.op = op;
+  header.reserved = 0;
+  header.size = U32(payload.size());
+  const U8 *headerBytes = reinterpret_cast<const U8*>(&header);
+
+  std::lock_guard<std::mutex> guard(Capture.mtx);
+  if(Capture.file == nullptr) {
+    return;
+  }
+
+  Capture.buffer.insert(Capture.buffer.end(), headerBytes, headerBytes + sizeof(header));
+  Capture.buffer.insert(Capture.buffer.end(), payload.begin(), payload.end());
+  if(Capture.buffer.size() >= CAPTURE_BUFFER_SIZE) {
+    flush();
+  }
+}
+
+void
+EvCapture::recordSceneWorld(
+    U64 scene,
+    U64 world)
+{
+  {
+    std::lock_guard<std::mutex> guard(Capture.mtx);
+    auto known = Capture.sceneWorlds.find(scene);
+    if(known != Capture.sceneWorlds.end() && known->second == world) {
+      return;
+    }
+    Capture.sceneWorlds[scene] = world;
+  }
+
+  record(EV_CAPTURE_SCENE_WORLD, scene, world);
+}
+
+void
+EvCapture::recordTransform(
+    U64 scene,
+    U64 object,
+    const F32 *matrix)
+{
+  EvCaptureMatrix transform;
+  memcpy(transform.m, matrix, sizeof(transform.m));
+
+  {
+    std::lock_guard<std::mutex> guard(Capture.mtx);
+    EvCaptureMatrix &last = Capture.transforms[{ scene, object }];
+    if(memcmp(&last, &transform, sizeof(transform)) == 0) {
+      return;
+    }
+    last = transform;
+  }
+
+  record(EV_CAPTURE_OBJECT_TRANSFORM, scene, object, transform);
+}
+
+EvCaptureReader::EvCaptureReader()
+  : file(nullptr)
+  , cursor(0)
+{}
+
+EvCaptureReader::~EvCaptureReader()
+{
+  if(file != nullptr) {
+    fclose(file);
+  }
+}
+
+bool
+EvCaptureReader::open(
+    const char *path)
+{
+  file = fopen(path, "rb");
+  if(file == nullptr) {
+    return false;
+  }
+
+  EvCapture::FileHeader header;
+  if(fread(&header, sizeof(header), 1, file) != 1
+      || header.magic != EvCapture::MAGIC
+      || header.version != EvCapture::VERSION
+      || header.pointerSize != sizeof(void*)) {
+    fclose(file);
+    file = nullptr;
+    return false;
+  }
+
+  return true;
+}
+
+bool
+EvCaptureReader::next(
+    EvCaptureOp &op)
+{
+  if(file == nullptr) {
+    return false;
+  }
+
+  EvCapture::RecordHeader header;
+  if(fread(&header, sizeof(header), 1, file) != 1) {
+    return false;
+  }
+
+  payload.resize(header.size);
+  cursor = 0;
+  if(header.size > 0 && fread(&payload[0], 1, header.size, file) != header.size) {
+    return false;
+  }
+
+  op = EvCaptureOp(header.op);
+  return true;
+}
+
+const char *
+EvCaptureReader::getString()
+{
+  U32 length = get<U32>();
+  if(length == 0 || cursor + length > payload.size() || payload[cursor + length - 1] != 0) {
+    cursor = payload.size();
+    return nullptr;
+  }
+
+  const char *str = reinterpret_cast<const char*>(&payload[cursor]);
+  cursor += length;
+  return str;
+}
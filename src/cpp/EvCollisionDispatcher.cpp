@@ -0,0 +1,32 @@
+#include <EvCollisionDispatcher.h>
+
+#include <LinearMath/btPoolAllocator.h>
+
+EvCollisionDispatcher::EvCollisionDispatcher(
+    btCollisionConfiguration *collisionConfiguration)
+  : btCollisionDispatcher(collisionConfiguration)
+  , manifoldPoolOverflows(0)
+  , algorithmPoolOverflows(0)
+{
+}
+
+btPersistentManifold *
+EvCollisionDispatcher::getNewManifold(
+    const btCollisionObject *body0,
+    const btCollisionObject *body1)
+{
+  if(m_persistentManifoldPoolAllocator->getFreeCount() == 0) {
+    manifoldPoolOverflows++;
+  }
+  return btCollisionDispatcher::getNewManifold(body0, body1);
+}
+
+void *
+EvCollisionDispatcher::allocateCollisionAlgorithm(
+    int size)
+{
+  if(m_collisionAlgorithmPoolAllocator->getFreeCount() == 0) {
+    algorithmPoolOverflows++;
+  }
+  return btCollisionDispatcher::allocateCollisionAlgorithm(size);
+}
@@ -0,0 +1,318 @@
+#include <EvConvexDecomposition.h>
+
+#include <LinearMath/btConvexHullComputer.h>
+#include <evol/common/ev_log.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#ifdef _WIN32
+#include <direct.h>
+#define ev_mkdir(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define ev_mkdir(path) mkdir(path, 0755)
+#endif
+
+#define EV_HULLCACHE_MAGIC 0x4c485645u // "EVHL"
+#define EV_HULLCACHE_VERSION 1u
+
+#define FNV_OFFSET_BASIS 0xcbf29ce484222325ull
+#define FNV_PRIME 0x100000001b3ull
+
+struct TriangleCluster {
+  std::vector<U32> triangles;
+  btVector3 aabbMin;
+  btVector3 aabbMax;
+  bool splittable;
+};
+
+static U64
+fnv1a(
+    U64 hash,
+    const void *data,
+    size_t size)
+{
+  const U8 *bytes = static_cast<const U8*>(data);
+  for(size_t i = 0; i < size; i++) {
+    hash ^= bytes[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
+// Creates every missing directory leading up to the file at `path`. Errors
+// are left to the caller's fopen, components like drive letters fail here
+// but exist anyway.
+static void
+createParentDirectories(
+    const char *path)
+{
+  std::string dir(path);
+  for(size_t i = 1; i < dir.size(); i++) {
+    if(dir[i] != '/' && dir[i] != '\\') {
+      continue;
+    }
+    char separator = dir[i];
+    dir[i] = '\0';
+    ev_mkdir(dir.c_str());
+    dir[i] = separator;
+  }
+}
+
+static btVector3
+triangleCentroid(
+    const btVector3 *vertices,
+    const U32 *indices,
+    U32 tri)
+{
+  return (vertices[indices[tri * 3 + 0]] +
+          vertices[indices[tri * 3 + 1]] +
+          vertices[indices[tri * 3 + 2]]) / btScalar(3);
+}
+
+static void
+updateClusterBounds(
+    TriangleCluster &cluster,
+    const btVector3 *vertices,
+    const U32 *indices)
+{
+  cluster.aabbMin.setValue(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+  cluster.aabbMax.setValue(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+  for(U32 tri : cluster.triangles) {
+    for(U32 v = 0; v < 3; v++) {
+      const btVector3 &vertex = vertices[indices[tri * 3 + v]];
+      cluster.aabbMin.setMin(vertex);
+      cluster.aabbMax.setMax(vertex);
+    }
+  }
+  cluster.splittable = cluster.triangles.size() > 1;
+}
+
+EvConvexDecomposition::EvConvexDecomposition(
+    U32 maxHulls,
+    U32 maxVerticesPerHull)
+  : maxHulls(maxHulls > 0 ? maxHulls : 1)
+  , maxVerticesPerHull(maxVerticesPerHull >= 4 ? maxVerticesPerHull : 4)
+{
+}
+
+void
+EvConvexDecomposition::compute(
+    const btVector3 *vertices,
+    U32 vertexCount,
+    const U32 *indices,
+    U32 indexCount)
+{
+  hulls.clear();
+
+  U32 triangleCount = indexCount / 3;
+  if(triangleCount == 0) {
+    return;
+  }
+
+  // Checked once here, the clustering below indexes vertices freely
+  for(U32 i = 0; i < triangleCount * 3; i++) {
+    if(indices[i] >= vertexCount) {
+      ev_log_warn("Convex decomposition: index %u out of range of %u vertices, mesh skipped", indices[i], vertexCount);
+      return;
+    }
+  }
+
+  std::vector<TriangleCluster> clusters(1);
+  clusters[0].triangles.resize(triangleCount);
+  for(U32 i = 0; i < triangleCount; i++) {
+    clusters[0].triangles[i] = i;
+  }
+  updateClusterBounds(clusters[0], vertices, indices);
+
+  while(clusters.size() < maxHulls) {
+    // Split the cluster with the largest bounds first
+    I32 target = -1;
+    btScalar targetVolume = -1;
+    for(U32 i = 0; i < clusters.size(); i++) {
+      if(!clusters[i].splittable) {
+        continue;
+      }
+      btVector3 extents = clusters[i].aabbMax - clusters[i].aabbMin;
+      btScalar volume = (extents.x() + SIMD_EPSILON) * (extents.y() + SIMD_EPSILON) * (extents.z() + SIMD_EPSILON);
+      if(volume > targetVolume) {
+        targetVolume = volume;
+        target = i;
+      }
+    }
+    if(target < 0) {
+      break;
+    }
+
+    TriangleCluster &cluster = clusters[target];
+    int axis = (cluster.aabbMax - cluster.aabbMin).maxAxis();
+    std::vector<U32> &tris = cluster.triangles;
+    auto mid = tris.begin() + tris.size() / 2;
+    std::nth_element(tris.begin(), mid, tris.end(), [&](U32 a, U32 b) {
+        return triangleCentroid(vertices, indices, a)[axis] < triangleCentroid(vertices, indices, b)[axis];
+    });
+
+    TriangleCluster upper;
+    upper.triangles.assign(mid, tris.end());
+    tris.erase(mid, tris.end());
+    updateClusterBounds(cluster, vertices, indices);
+    updateClusterBounds(upper, vertices, indices);
+    clusters.push_back(std::move(upper));
+  }
+
+  Hull clusterPoints;
+  for(const TriangleCluster &cluster : clusters) {
+    clusterPoints.resize(0);
+    for(U32 tri : cluster.triangles) {
+      for(U32 v = 0; v < 3; v++) {
+        clusterPoints.push_back(vertices[indices[tri * 3 + v]]);
+      }
+    }
+
+    if(clusterPoints.size() == 0) {
+      continue;
+    }
+
+    hulls.emplace_back();
+    buildSimplifiedHull(&clusterPoints[0], clusterPoints.size(), maxVerticesPerHull, hulls.back());
+    if(hulls.back().size() < 4) {
+      hulls.pop_back();
+    }
+  }
+}
+
+U64
+EvConvexDecomposition::hash(
+    const btVector3 *vertices,
+    U32 vertexCount,
+    const U32 *indices,
+    U32 indexCount) const
+{
+  U64 hash = FNV_OFFSET_BASIS;
+  hash = fnv1a(hash, &maxHulls, sizeof(maxHulls));
+  hash = fnv1a(hash, &maxVerticesPerHull, sizeof(maxVerticesPerHull));
+  for(U32 i = 0; i < vertexCount; i++) {
+    hash = fnv1a(hash, vertices[i].m_floats, sizeof(btScalar) * 3);
+  }
+  hash = fnv1a(hash, indices, sizeof(U32) * indexCount);
+  return hash;
+}
+
+bool
+EvConvexDecomposition::load(
+    const char *path)
+{
+  FILE *file = fopen(path, "rb");
+  if(file == nullptr) {
+    return false;
+  }
+
+  bool success = false;
+  U32 header[3];
+  // Counts are checked against this decomposition's budget, a corrupt file
+  // can't make us allocate more than a computed decomposition would, nor
+  // hand out a hull too small to build a shape from
+  if(fread(header, sizeof(U32), 3, file) == 3 &&
+     header[0] == EV_HULLCACHE_MAGIC &&
+     header[1] == EV_HULLCACHE_VERSION &&
+     header[2] <= maxHulls) {
+    hulls.clear();
+    hulls.resize(header[2]);
+    success = true;
+    for(U32 i = 0; i < header[2] && success; i++) {
+      U32 vertexCount;
+      success = fread(&vertexCount, sizeof(U32), 1, file) == 1
+        && vertexCount >= 4
+        && vertexCount <= maxVerticesPerHull;
+      if(success) {
+        hulls[i].reserve(vertexCount);
+      }
+      for(U32 v = 0; v < vertexCount && success; v++) {
+        F32 point[3];
+        success = fread(point, sizeof(F32), 3, file) == 3;
+        hulls[i].push_back(btVector3(point[0], point[1], point[2]));
+      }
+    }
+  }
+
+  if(!success) {
+    hulls.clear();
+  }
+
+  fclose(file);
+  return success;
+}
+
+bool
+EvConvexDecomposition::save(
+    const char *path) const
+{
+  FILE *file = fopen(path, "wb");
+  if(file == nullptr) {
+    // The cache directory is created on the first save
+    createParentDirectories(path);
+    file = fopen(path, "wb");
+  }
+  if(file == nullptr) {
+    return false;
+  }
+
+  U32 header[3] = { EV_HULLCACHE_MAGIC, EV_HULLCACHE_VERSION, (U32)hulls.size() };
+  bool success = fwrite(header, sizeof(U32), 3, file) == 3;
+  for(U32 i = 0; i < hulls.size() && success; i++) {
+    U32 vertexCount = hulls[i].size();
+    success = fwrite(&vertexCount, sizeof(U32), 1, file) == 1;
+    for(U32 v = 0; v < vertexCount && success; v++) {
+      F32 point[3] = { (F32)hulls[i][v].x(), (F32)hulls[i][v].y(), (F32)hulls[i][v].z() };
+      success = fwrite(point, sizeof(F32), 3, file) == 3;
+    }
+  }
+
+  fclose(file);
+  if(!success) {
+    remove(path);
+  }
+  return success;
+}
+
+void
+EvConvexDecomposition::buildSimplifiedHull(
+    const btVector3 *points,
+    U32 pointCount,
+    U32 maxVertices,
+    Hull &hull)
+{
+  hull.resize(0);
+  if(pointCount == 0) {
+    return;
+  }
+
+  btConvexHullComputer hullComputer;
+  hullComputer.compute(points[0].m_floats, sizeof(btVector3), pointCount, 0, 0);
+
+  const btAlignedObjectArray<btVector3> &hullVertices = hullComputer.vertices;
+  if((U32)hullVertices.size() <= maxVertices) {
+    hull = hullVertices;
+    return;
+  }
+
+  // Support points along a fibonacci sphere of directions
+  btAlignedObjectArray<bool> picked;
+  picked.resize(hullVertices.size(), false);
+  const btScalar goldenAngle = SIMD_PI * (btScalar(3) - btSqrt(btScalar(5)));
+  for(U32 k = 0; k < maxVertices; k++) {
+    btScalar y = btScalar(1) - (btScalar(k) + btScalar(0.5)) * btScalar(2) / btScalar(maxVertices);
+    btScalar r = btSqrt(btMax(btScalar(0), btScalar(1) - y * y));
+    btScalar theta = goldenAngle * btScalar(k);
+    btVector3 dir(btCos(theta) * r, y, btSin(theta) * r);
+
+    btScalar support;
+    long best = dir.maxDot(&hullVertices[0], hullVertices.size(), support);
+    if(best >= 0 && !picked[best]) {
+      picked[best] = true;
+      hull.push_back(hullVertices[best]);
+    }
+  }
+}
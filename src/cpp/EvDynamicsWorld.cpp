@@ -0,0 +1,602 @@
+#include <EvDynamicsWorld.h>
+
+#include <BulletCollision/BroadphaseCollision/btDbvtBroadphase.h>
+#include <LinearMath/btQuickprof.h>
+#include <LinearMath/btTransformUtil.h>
+
+#include <algorithm>
+#include <vector>
+
+// Same as the stage list helpers private to btDbvtBroadphase.cpp
+static inline void
+dbvtListAppend(
+    btDbvtProxy *item,
+    btDbvtProxy *&list)
+{
+  item->links[0] = nullptr;
+  item->links[1] = list;
+  if(list) {
+    list->links[0] = item;
+  }
+  list = item;
+}
+
+static inline void
+dbvtListRemove(
+    btDbvtProxy *item,
+    btDbvtProxy *&list)
+{
+  if(item->links[0]) {
+    item->links[0]->links[1] = item->links[1];
+  } else {
+    list = item->links[1];
+  }
+  if(item->links[1]) {
+    item->links[1]->links[0] = item->links[0];
+  }
+}
+
+struct FilteredPairCallback : public btOverlapCallback
+{
+  bool processOverlap(btBroadphasePair &pair) override
+  {
+    return !((pair.m_pProxy0->m_collisionFilterGroup & pair.m_pProxy1->m_collisionFilterMask) &&
+             (pair.m_pProxy1->m_collisionFilterGroup & pair.m_pProxy0->m_collisionFilterMask));
+  }
+};
+
+static inline EvDynamicsWorld::LodTier
+getLodTier(
+    const btCollisionObject *object)
+{
+  // Bullet initializes user indices to -1
+  return object->getUserIndex3() > 0 ? static_cast<EvDynamicsWorld::LodTier>(object->getUserIndex3()) : EvDynamicsWorld::LOD_FULL;
+}
+
+struct RemovedProxyPairCallback : public btOverlapCallback
+{
+  const std::vector<btBroadphaseProxy*> &removedProxies;
+
+  RemovedProxyPairCallback(const std::vector<btBroadphaseProxy*> &proxies)
+    : removedProxies(proxies)
+  {}
+
+  bool processOverlap(btBroadphasePair &pair) override
+  {
+    return std::binary_search(removedProxies.begin(), removedProxies.end(), pair.m_pProxy0) ||
+           std::binary_search(removedProxies.begin(), removedProxies.end(), pair.m_pProxy1);
+  }
+};
+
+EvDynamicsWorld::EvDynamicsWorld(
+    btDispatcher *dispatcher,
+    btBroadphaseInterface *broadphase,
+    btConstraintSolver *solver,
+    btCollisionConfiguration *collisionConfiguration)
+#if BT_THREADSAFE
+  : btDiscreteDynamicsWorldMt(dispatcher, broadphase, static_cast<btConstraintSolverPoolMt*>(solver), nullptr, collisionConfiguration)
+#else
+  : btDiscreteDynamicsWorld(dispatcher, broadphase, solver, collisionConfiguration)
+#endif
+  , broadphaseTime(0)
+  , lodInterval(1)
+  , lodTick(0)
+  , lodNextPhase(0)
+  , lodPairsDirty(false)
+  , staticsFrozen(false)
+{
+}
+
+void
+EvDynamicsWorld::removeCollisionObjects(
+    btCollisionObject **objects,
+    int count)
+{
+  std::vector<btBroadphaseProxy*> removedProxies;
+  removedProxies.reserve(count);
+  for(int i = 0; i < count; ++i) {
+    if(objects[i] != nullptr && objects[i]->getBroadphaseHandle() != nullptr) {
+      removedProxies.push_back(objects[i]->getBroadphaseHandle());
+    }
+  }
+  std::sort(removedProxies.begin(), removedProxies.end());
+
+  // One sweep over the pair cache for all removed proxies
+  btOverlappingPairCache *pairCache = getBroadphase()->getOverlappingPairCache();
+  RemovedProxyPairCallback removedPairs(removedProxies);
+  pairCache->processAllOverlappingPairs(&removedPairs, getDispatcher());
+
+  // All pairs are gone already, so the DBVT broadphase can skip its per-proxy
+  // pair cleanup while the proxies are destroyed.
+  btDbvtBroadphase *dbvt = dynamic_cast<btDbvtBroadphase*>(getBroadphase());
+  btNullPairCache nullPairCache;
+  if(dbvt != nullptr) {
+    dbvt->m_paircache = &nullPairCache;
+  }
+
+  for(int i = 0; i < count; ++i) {
+    btCollisionObject *object = objects[i];
+    if(object == nullptr || object->getWorldArrayIndex() < 0) {
+      continue;
+    }
+    btCollisionWorld::removeCollisionObject(object);
+  }
+
+  if(dbvt != nullptr) {
+    dbvt->m_paircache = pairCache;
+  }
+
+  int kept = 0;
+  for(int i = 0; i < kinematicBodies.size(); ++i) {
+    if(kinematicBodies[i].body->getWorldArrayIndex() >= 0) {
+      kinematicBodies[kept++] = kinematicBodies[i];
+    }
+  }
+  kinematicBodies.resize(kept);
+
+  kept = 0;
+  for(int i = 0; i < looseObjects.size(); ++i) {
+    if(looseObjects[i]->getWorldArrayIndex() >= 0) {
+      looseObjects[kept++] = looseObjects[i];
+    }
+  }
+  looseObjects.resize(kept);
+
+  kept = 0;
+  for(int i = 0; i < m_nonStaticRigidBodies.size(); ++i) {
+    btRigidBody *body = m_nonStaticRigidBodies[i];
+    if(body->getWorldArrayIndex() >= 0) {
+      m_nonStaticRigidBodies[kept++] = body;
+    }
+  }
+  m_nonStaticRigidBodies.resize(kept);
+
+  kept = 0;
+  for(int i = 0; i < lodBodies.size(); ++i) {
+    LodBody &lodBody = lodBodies[i];
+    if(lodBody.body->getWorldArrayIndex() >= 0) {
+      lodBody.body->setUserIndex2(kept);
+      lodBodies[kept++] = lodBody;
+    } else {
+      lodBody.body->applyCentralImpulse(lodBody.heldImpulse);
+      lodBody.body->applyTorqueImpulse(lodBody.heldTorqueImpulse);
+      lodBody.body->setUserIndex3(LOD_FULL);
+    }
+  }
+  lodBodies.resize(kept);
+}
+
+void
+EvDynamicsWorld::removeConstraints(
+    btTypedConstraint **constraints,
+    int count)
+{
+  std::vector<btTypedConstraint*> removed(constraints, constraints + count);
+  std::sort(removed.begin(), removed.end());
+
+  for(btTypedConstraint *constraint : removed) {
+    constraint->getRigidBodyA().removeConstraintRef(constraint);
+    constraint->getRigidBodyB().removeConstraintRef(constraint);
+  }
+
+  int kept = 0;
+  for(int i = 0; i < m_constraints.size(); ++i) {
+    btTypedConstraint *constraint = m_constraints[i];
+    if(!std::binary_search(removed.begin(), removed.end(), constraint)) {
+      m_constraints[kept++] = constraint;
+    }
+  }
+  m_constraints.resize(kept);
+}
+
+void
+EvDynamicsWorld::setBodyLod(
+    btRigidBody *body,
+    LodTier tier)
+{
+  // The tier lives in the body's third user index, nothing else uses it
+  LodTier current = getLodTier(body);
+  if(current == tier) {
+    return;
+  }
+
+  btBroadphaseProxy *proxy = body->getBroadphaseHandle();
+  if(current == LOD_FULL) {
+    addLodBody(body);
+  }
+
+  // The lower tiers narrow the body's own filter instead of replacing it
+  LodBody &lodBody = lodBodies[body->getUserIndex2()];
+  int filterGroup = lodBody.filterGroup;
+  int filterMask = lodBody.filterMask;
+  switch(tier) {
+    case LOD_FULL:
+      removeLodBody(body);
+      break;
+    case LOD_REDUCED:
+      filterGroup = btBroadphaseProxy::DebrisFilter;
+      filterMask &= ~btBroadphaseProxy::DebrisFilter;
+      break;
+    case LOD_BALLISTIC:
+      filterGroup = btBroadphaseProxy::DebrisFilter;
+      filterMask &= btBroadphaseProxy::StaticFilter | btBroadphaseProxy::CharacterFilter;
+      break;
+  }
+  body->setUserIndex3(tier);
+
+  if(proxy == nullptr) {
+    return;
+  }
+  proxy->m_collisionFilterGroup = filterGroup;
+  proxy->m_collisionFilterMask = filterMask;
+
+  if(tier < current) {
+    // The filter got wider. Incremental broadphases only report pairs for
+    // proxies that move, so the proxy is re-inserted to pick up the overlaps
+    // it was filtered out of.
+    refreshBroadphaseProxy(body);
+  } else {
+    lodPairsDirty = true;
+  }
+}
+
+void
+EvDynamicsWorld::addLodBody(
+    btRigidBody *body)
+{
+  body->setUserIndex2(lodBodies.size());
+  LodBody &lodBody = lodBodies.expandNonInitializing();
+  lodBody.body = body;
+  lodBody.phase = lodNextPhase++;
+  lodBody.heldImpulse.setZero();
+  lodBody.heldTorqueImpulse.setZero();
+
+  btBroadphaseProxy *proxy = body->getBroadphaseHandle();
+  if(proxy != nullptr) {
+    lodBody.filterGroup = proxy->m_collisionFilterGroup;
+    lodBody.filterMask = proxy->m_collisionFilterMask;
+  } else {
+    lodBody.filterGroup = btBroadphaseProxy::DefaultFilter;
+    lodBody.filterMask = btBroadphaseProxy::AllFilter;
+  }
+}
+
+// Forces still held for the body's next turn are applied right away
+void
+EvDynamicsWorld::removeLodBody(
+    btRigidBody *body)
+{
+  int index = body->getUserIndex2();
+  LodBody &lodBody = lodBodies[index];
+  body->applyCentralImpulse(lodBody.heldImpulse);
+  body->applyTorqueImpulse(lodBody.heldTorqueImpulse);
+
+  int last = lodBodies.size() - 1;
+  if(index != last) {
+    lodBodies[index] = lodBodies[last];
+    lodBodies[index].body->setUserIndex2(index);
+  }
+  lodBodies.pop_back();
+  body->setUserIndex2(-1);
+}
+
+void
+EvDynamicsWorld::setLodInterval(
+    int interval)
+{
+  lodInterval = btMax(interval, 1);
+}
+
+// Same interpolation as synchronizeSingleMotionState
+void
+EvDynamicsWorld::getInterpolatedTransform(
+    const btRigidBody *body,
+    btTransform &transform) const
+{
+  btScalar localTime = (m_latencyMotionStateInterpolation && m_fixedTimeStep)
+    ? m_localTime - m_fixedTimeStep
+    : m_localTime * body->getHitFraction();
+  btTransformUtil::integrateTransform(
+      body->getInterpolationWorldTransform(),
+      body->getInterpolationLinearVelocity(),
+      body->getInterpolationAngularVelocity(),
+      localTime,
+      transform);
+}
+
+void
+EvDynamicsWorld::trackRigidBody(
+    btRigidBody *body)
+{
+  if(body->isKinematicObject() && body->getWorldArrayIndex() >= 0) {
+    KinematicBody kinematic;
+    kinematic.body = body;
+    kinematic.motionState = dynamic_cast<EvPolledMotionState*>(body->getMotionState());
+    kinematicBodies.push_back(kinematic);
+  }
+}
+
+void
+EvDynamicsWorld::addRigidBody(
+    btRigidBody *body)
+{
+  EvDynamicsWorldBase::addRigidBody(body);
+  trackRigidBody(body);
+}
+
+void
+EvDynamicsWorld::addRigidBody(
+    btRigidBody *body,
+    int group,
+    int mask)
+{
+  EvDynamicsWorldBase::addRigidBody(body, group, mask);
+  trackRigidBody(body);
+}
+
+void
+EvDynamicsWorld::removeRigidBody(
+    btRigidBody *body)
+{
+  if(getLodTier(body) != LOD_FULL) {
+    removeLodBody(body);
+    body->setUserIndex3(LOD_FULL);
+  }
+  if(body->isKinematicObject()) {
+    for(int i = 0; i < kinematicBodies.size(); ++i) {
+      if(kinematicBodies[i].body == body) {
+        kinematicBodies.swap(i, kinematicBodies.size() - 1);
+        kinematicBodies.pop_back();
+        break;
+      }
+    }
+  }
+  EvDynamicsWorldBase::removeRigidBody(body);
+}
+
+void
+EvDynamicsWorld::addCollisionObject(
+    btCollisionObject *object,
+    int collisionFilterGroup,
+    int collisionFilterMask)
+{
+  EvDynamicsWorldBase::addCollisionObject(object, collisionFilterGroup, collisionFilterMask);
+  // Rigid bodies come through here too, they are tracked by addRigidBody
+  if(btRigidBody::upcast(object) == nullptr && !object->isStaticObject()) {
+    looseObjects.push_back(object);
+  }
+}
+
+void
+EvDynamicsWorld::removeCollisionObject(
+    btCollisionObject *object)
+{
+  if(btRigidBody::upcast(object) == nullptr && !object->isStaticObject()) {
+    looseObjects.remove(object);
+  }
+  EvDynamicsWorldBase::removeCollisionObject(object);
+}
+
+// Static objects sleep and never need their AABBs recomputed, they are
+// refreshed explicitly when moved. Skipping them keeps large static worlds
+// out of the per-step loop.
+void
+EvDynamicsWorld::updateAabbs()
+{
+  if(getForceUpdateAllAabbs()) {
+    EvDynamicsWorldBase::updateAabbs();
+    return;
+  }
+
+  BT_PROFILE("updateAabbs");
+  for(int i = 0; i < m_nonStaticRigidBodies.size(); ++i) {
+    btRigidBody *body = m_nonStaticRigidBodies[i];
+    if(body->isActive()) {
+      updateSingleAabb(body);
+    }
+  }
+  for(int i = 0; i < looseObjects.size(); ++i) {
+    if(looseObjects[i]->isActive()) {
+      updateSingleAabb(looseObjects[i]);
+    }
+  }
+}
+
+// Replaces Bullet's pass over every collision object. Kinematic bodies whose
+// transform didn't change since the last step are put to sleep with zero
+// velocity, so the steps skip them entirely. Moving them again wakes them,
+// and the bodies resting on them with them.
+void
+EvDynamicsWorld::saveKinematicState(
+    btScalar timeStep)
+{
+  if(timeStep == btScalar(0.)) {
+    return;
+  }
+
+  btTransform transform;
+  for(int i = 0; i < kinematicBodies.size(); ++i) {
+    btRigidBody *body = kinematicBodies[i].body;
+    EvPolledMotionState *motionState = kinematicBodies[i].motionState;
+    if(motionState == nullptr) {
+      if(body->getActivationState() != ISLAND_SLEEPING) {
+        body->saveKinematicState(timeStep);
+      }
+      continue;
+    }
+
+    if(!motionState->pollWorldTransform(transform)) {
+      if(body->getActivationState() != ISLAND_SLEEPING) {
+        body->forceActivationState(ISLAND_SLEEPING);
+        body->setLinearVelocity(btVector3(0, 0, 0));
+        body->setAngularVelocity(btVector3(0, 0, 0));
+        body->setInterpolationLinearVelocity(btVector3(0, 0, 0));
+        body->setInterpolationAngularVelocity(btVector3(0, 0, 0));
+      }
+      continue;
+    }
+
+    if(body->getActivationState() == ISLAND_SLEEPING) {
+      body->forceActivationState(DISABLE_DEACTIVATION);
+    }
+
+    // Same as btRigidBody::saveKinematicState, with the polled transform
+    btVector3 linearVelocity, angularVelocity;
+    btTransformUtil::calculateVelocity(body->getInterpolationWorldTransform(), transform, timeStep, linearVelocity, angularVelocity);
+    body->setWorldTransform(transform);
+    body->setInterpolationWorldTransform(transform);
+    body->setLinearVelocity(linearVelocity);
+    body->setAngularVelocity(angularVelocity);
+    body->setInterpolationLinearVelocity(linearVelocity);
+    body->setInterpolationAngularVelocity(angularVelocity);
+  }
+}
+
+void
+EvDynamicsWorld::internalSingleStepSimulation(
+    btScalar timeStep)
+{
+  if(lodBodies.size() == 0 || lodInterval == 1) {
+    EvDynamicsWorldBase::internalSingleStepSimulation(timeStep);
+    return;
+  }
+
+  lodTick++;
+  heldBodies.resize(lodBodies.size());
+
+  // Each body gets its turn once per interval, spread over the ticks so the
+  // cost stays flat. On its turn a body moves as if stepped with the whole
+  // interval: velocities are scaled by the interval, then scaled back after
+  // the step. The forces of the held steps, gravity included, are summed up
+  // and applied with the turn's own, scaled by the interval as well, so a
+  // constant force ends up scaled by its square. Off-turn bodies are frozen
+  // and their velocities restored afterwards, so contacts don't build up on
+  // them.
+  btScalar scale = btScalar(lodInterval);
+  for(int i = 0; i < lodBodies.size(); ++i) {
+    LodBody &lodBody = lodBodies[i];
+    btRigidBody *body = lodBody.body;
+    HeldBody &state = heldBodies[i];
+    state.held = false;
+    state.scaled = false;
+    if(!body->isActive()) {
+      continue;
+    }
+
+    if((lodTick + lodBody.phase) % lodInterval == 0) {
+      state.scaled = true;
+      state.totalForce = body->getTotalForce();
+      state.totalTorque = body->getTotalTorque();
+      btVector3 force = (state.totalForce + lodBody.heldImpulse / timeStep) * scale;
+      btVector3 torque = (state.totalTorque + lodBody.heldTorqueImpulse / timeStep) * scale;
+      lodBody.heldImpulse.setZero();
+      lodBody.heldTorqueImpulse.setZero();
+
+      body->setLinearVelocity(body->getLinearVelocity() * scale);
+      body->setAngularVelocity(body->getAngularVelocity() * scale);
+      body->clearForces();
+      body->applyCentralForce(force);
+      body->applyTorque(torque);
+    } else {
+      // Forces stay on the body for the whole progress call, every held
+      // substep adds its share
+      lodBody.heldImpulse += body->getTotalForce() * timeStep;
+      lodBody.heldTorqueImpulse += body->getTotalTorque() * timeStep;
+      state.held = true;
+      state.linearVelocity = body->getLinearVelocity();
+      state.angularVelocity = body->getAngularVelocity();
+      state.activationState = body->getActivationState();
+      body->forceActivationState(DISABLE_SIMULATION);
+    }
+  }
+
+  EvDynamicsWorldBase::internalSingleStepSimulation(timeStep);
+
+  for(int i = 0; i < lodBodies.size(); ++i) {
+    btRigidBody *body = lodBodies[i].body;
+    HeldBody &state = heldBodies[i];
+    if(state.held) {
+      body->forceActivationState(state.activationState);
+      body->setLinearVelocity(state.linearVelocity);
+      body->setAngularVelocity(state.angularVelocity);
+      // Motion prediction still ran on the held body
+      body->setInterpolationWorldTransform(body->getWorldTransform());
+      body->setInterpolationLinearVelocity(state.linearVelocity);
+      body->setInterpolationAngularVelocity(state.angularVelocity);
+    } else if(state.scaled) {
+      body->setLinearVelocity(body->getLinearVelocity() / scale);
+      body->setAngularVelocity(body->getAngularVelocity() / scale);
+      // Later substeps of the same progress call get the unscaled forces
+      body->clearForces();
+      body->applyCentralForce(state.totalForce);
+      body->applyTorque(state.totalTorque);
+    }
+  }
+}
+
+void
+EvDynamicsWorld::computeOverlappingPairs()
+{
+  btClock clock;
+  EvDynamicsWorldBase::computeOverlappingPairs();
+
+  // Bodies moved down an LOD tier since the last step, drop the pairs their
+  // narrower filter excludes
+  if(lodPairsDirty) {
+    FilteredPairCallback filteredPairs;
+    getBroadphase()->getOverlappingPairCache()->processAllOverlappingPairs(&filteredPairs, getDispatcher());
+    lodPairsDirty = false;
+  }
+
+  broadphaseTime += clock.getTimeMicroseconds();
+}
+
+bool
+EvDynamicsWorld::moveToStaticSet(
+    btDbvtBroadphase *dbvt,
+    btCollisionObject *object)
+{
+  btDbvtProxy *proxy = static_cast<btDbvtProxy*>(object->getBroadphaseHandle());
+  if(!object->isStaticObject() || proxy == nullptr || proxy->stage == btDbvtBroadphase::STAGECOUNT) {
+    return false;
+  }
+
+  dbvtListRemove(proxy, dbvt->m_stageRoots[proxy->stage]);
+  dbvtListAppend(proxy, dbvt->m_stageRoots[btDbvtBroadphase::STAGECOUNT]);
+  dbvt->m_sets[btDbvtBroadphase::DYNAMIC_SET].remove(proxy->leaf);
+  proxy->leaf = dbvt->m_sets[btDbvtBroadphase::FIXED_SET].insert(btDbvtVolume::FromMM(proxy->m_aabbMin, proxy->m_aabbMax), proxy);
+  proxy->stage = btDbvtBroadphase::STAGECOUNT;
+  return true;
+}
+
+void
+EvDynamicsWorld::freezeStaticObjects()
+{
+  btDbvtBroadphase *dbvt = dynamic_cast<btDbvtBroadphase*>(getBroadphase());
+  if(dbvt == nullptr) {
+    return;
+  }
+  staticsFrozen = true;
+
+  for(int i = 0; i < m_collisionObjects.size(); ++i) {
+    moveToStaticSet(dbvt, m_collisionObjects[i]);
+  }
+
+  dbvt->m_sets[btDbvtBroadphase::FIXED_SET].optimizeTopDown();
+  // Nothing left for the incremental optimizer to do on the static tree
+  dbvt->m_fixedleft = 0;
+  dbvt->m_needcleanup = true;
+}
+
+void
+EvDynamicsWorld::freezeStaticObject(
+    btCollisionObject *object)
+{
+  if(!staticsFrozen) {
+    return;
+  }
+  btDbvtBroadphase *dbvt = dynamic_cast<btDbvtBroadphase*>(getBroadphase());
+  if(dbvt != nullptr && moveToStaticSet(dbvt, object)) {
+    dbvt->m_needcleanup = true;
+  }
+}
@@ -0,0 +1,95 @@
+#include <EvGameStub.h>
+#include <EvObjectKey.h>
+
+#include <mutex>
+#include <unordered_map>
+
+// Column-major, as the game stores it
+struct ObjectTransform {
+  btScalar m[16];
+};
+
+static struct {
+  std::mutex mtx;
+  std::unordered_map<U64, U64> sceneWorlds;
+  std::unordered_map<EvObjectKey, ObjectTransform, EvObjectKeyHash> transforms;
+} Stub;
+
+bool EvGameStub::active = false;
+
+void
+EvGameStub::setActive(
+    bool enable)
+{
+  std::lock_guard<std::mutex> guard(Stub.mtx);
+  active = enable;
+  if(!enable) {
+    Stub.sceneWorlds.clear();
+    Stub.transforms.clear();
+  }
+}
+
+void
+EvGameStub::setSceneWorld(
+    U64 scene,
+    U64 world)
+{
+  std::lock_guard<std::mutex> guard(Stub.mtx);
+  Stub.sceneWorlds[scene] = world;
+}
+
+U64
+EvGameStub::getSceneWorld(
+    U64 scene)
+{
+  std::lock_guard<std::mutex> guard(Stub.mtx);
+  auto world = Stub.sceneWorlds.find(scene);
+  return world != Stub.sceneWorlds.end() ? world->second : ~0ull;
+}
+
+void
+EvGameStub::getTransform(
+    U64 scene,
+    U64 object,
+    btTransform &transform)
+{
+  std::lock_guard<std::mutex> guard(Stub.mtx);
+  auto stored = Stub.transforms.find({ scene, object });
+  if(stored == Stub.transforms.end()) {
+    transform.setIdentity();
+    return;
+  }
+  transform.setFromOpenGLMatrix(stored->second.m);
+}
+
+void
+EvGameStub::getMatrix(
+    U64 scene,
+    U64 object,
+    F32 *matrix)
+{
+  std::lock_guard<std::mutex> guard(Stub.mtx);
+  auto stored = Stub.transforms.find({ scene, object });
+  if(stored == Stub.transforms.end()) {
+    for(int i = 0; i < 16; i++) {
+      matrix[i] = (i % 5 == 0) ? 1.f : 0.f;
+    }
+    return;
+  }
+  for(int i = 0; i < 16; i++) {
+    matrix[i] = stored->second.m[i];
+  }
+}
+
+void
+EvGameStub::setTransform(
+    U64 scene,
+    U64 object,
+    const F32 *matrix)
+{
+  std::lock_guard<std::mutex> guard(Stub.mtx);
+  ObjectTransform &transform = Stub.transforms[{ scene, object }];
+  for(int i = 0; i < 16; i++) {
+    transform.m[i] = matrix[i];
+  }
+}
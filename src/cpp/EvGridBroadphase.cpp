@@ -0,0 +1,288 @@
+#include <EvGridBroadphase.h>
+
+#include <BulletCollision/BroadphaseCollision/btDispatcher.h>
+#include <LinearMath/btAabbUtil2.h>
+#include <evol/common/ev_log.h>
+
+// Proxies covering more cells than this are tested against every proxy
+// instead of being binned.
+#define MAX_PROXY_CELLS 64
+
+#define CELL_BITS 21
+#define CELL_MASK ((1ull << CELL_BITS) - 1)
+
+// Cell coordinates that fit the key without aliasing. Proxies reaching past
+// them are handled like oversized ones.
+#define CELL_COORD_MIN (-(1 << (CELL_BITS - 1)))
+#define CELL_COORD_MAX ((1 << (CELL_BITS - 1)) - 1)
+
+static inline U64
+cellKey(
+    I32 x,
+    I32 y,
+    I32 z)
+{
+  return (((U64)x & CELL_MASK) << (CELL_BITS * 2)) |
+         (((U64)y & CELL_MASK) << CELL_BITS) |
+         ((U64)z & CELL_MASK);
+}
+
+struct RemoveSeparatedPairsCallback : public btOverlapCallback
+{
+  bool processOverlap(btBroadphasePair &pair) override
+  {
+    return !TestAabbAgainstAabb2(
+        pair.m_pProxy0->m_aabbMin, pair.m_pProxy0->m_aabbMax,
+        pair.m_pProxy1->m_aabbMin, pair.m_pProxy1->m_aabbMax);
+  }
+};
+
+EvGridBroadphase::EvGridBroadphase(
+    btScalar cellSize)
+  : cellSize(cellSize > 0 ? cellSize : btScalar(1))
+  , uidCounter(0)
+  , boundsMin(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT)
+  , boundsMax(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT)
+{
+  invCellSize = btScalar(1) / this->cellSize;
+  pairCache = new btHashedOverlappingPairCache();
+}
+
+EvGridBroadphase::~EvGridBroadphase()
+{
+  for(int i = 0; i < proxies.size(); ++i) {
+    delete proxies[i];
+  }
+
+  delete pairCache;
+}
+
+bool
+EvGridBroadphase::cellRange(
+    const btBroadphaseProxy *proxy,
+    I32 minCell[3],
+    I32 maxCell[3]) const
+{
+  for(int axis = 0; axis < 3; ++axis) {
+    // Range checked before the conversion, which is undefined for values
+    // that don't fit an I32
+    btScalar lo = btFloor(proxy->m_aabbMin[axis] * invCellSize);
+    btScalar hi = btFloor(proxy->m_aabbMax[axis] * invCellSize);
+    if(!(lo >= btScalar(CELL_COORD_MIN) && hi <= btScalar(CELL_COORD_MAX))) {
+      return false;
+    }
+    minCell[axis] = (I32)lo;
+    maxCell[axis] = (I32)hi;
+  }
+  return true;
+}
+
+void
+EvGridBroadphase::testPair(
+    EvGridProxy *proxy0,
+    EvGridProxy *proxy1)
+{
+  if(TestAabbAgainstAabb2(proxy0->m_aabbMin, proxy0->m_aabbMax, proxy1->m_aabbMin, proxy1->m_aabbMax)) {
+    // The hashed cache filters on collision groups and ignores known pairs
+    pairCache->addOverlappingPair(proxy0, proxy1);
+  }
+}
+
+btBroadphaseProxy *
+EvGridBroadphase::createProxy(
+    const btVector3 &aabbMin,
+    const btVector3 &aabbMax,
+    int shapeType,
+    void *userPtr,
+    int collisionFilterGroup,
+    int collisionFilterMask,
+    btDispatcher *dispatcher)
+{
+  (void)shapeType;
+  (void)dispatcher;
+
+  EvGridProxy *proxy = new EvGridProxy(aabbMin, aabbMax, userPtr, collisionFilterGroup, collisionFilterMask);
+  proxy->m_uniqueId = ++uidCounter;
+  proxy->index = proxies.size();
+  proxies.push_back(proxy);
+
+  return proxy;
+}
+
+void
+EvGridBroadphase::destroyProxy(
+    btBroadphaseProxy *absproxy,
+    btDispatcher *dispatcher)
+{
+  EvGridProxy *proxy = static_cast<EvGridProxy*>(absproxy);
+  pairCache->removeOverlappingPairsContainingProxy(proxy, dispatcher);
+
+  I32 last = proxies.size() - 1;
+  proxies[proxy->index] = proxies[last];
+  proxies[proxy->index]->index = proxy->index;
+  proxies.pop_back();
+
+  delete proxy;
+}
+
+void
+EvGridBroadphase::setAabb(
+    btBroadphaseProxy *proxy,
+    const btVector3 &aabbMin,
+    const btVector3 &aabbMax,
+    btDispatcher *dispatcher)
+{
+  (void)dispatcher;
+  proxy->m_aabbMin = aabbMin;
+  proxy->m_aabbMax = aabbMax;
+}
+
+void
+EvGridBroadphase::getAabb(
+    btBroadphaseProxy *proxy,
+    btVector3 &aabbMin,
+    btVector3 &aabbMax) const
+{
+  aabbMin = proxy->m_aabbMin;
+  aabbMax = proxy->m_aabbMax;
+}
+
+void
+EvGridBroadphase::rayTest(
+    const btVector3 &rayFrom,
+    const btVector3 &rayTo,
+    btBroadphaseRayCallback &rayCallback,
+    const btVector3 &aabbMin,
+    const btVector3 &aabbMax)
+{
+  (void)rayTo;
+
+  for(int i = 0; i < proxies.size(); ++i) {
+    btBroadphaseProxy *proxy = proxies[i];
+    btVector3 bounds[2] = {
+      proxy->m_aabbMin - aabbMax,
+      proxy->m_aabbMax - aabbMin,
+    };
+    btScalar tmin;
+    if(btRayAabb2(rayFrom, rayCallback.m_rayDirectionInverse, rayCallback.m_signs, bounds, tmin, 0, rayCallback.m_lambda_max)) {
+      rayCallback.process(proxy);
+    }
+  }
+}
+
+void
+EvGridBroadphase::aabbTest(
+    const btVector3 &aabbMin,
+    const btVector3 &aabbMax,
+    btBroadphaseAabbCallback &callback)
+{
+  for(int i = 0; i < proxies.size(); ++i) {
+    btBroadphaseProxy *proxy = proxies[i];
+    if(TestAabbAgainstAabb2(aabbMin, aabbMax, proxy->m_aabbMin, proxy->m_aabbMax)) {
+      callback.process(proxy);
+    }
+  }
+}
+
+void
+EvGridBroadphase::calculateOverlappingPairs(
+    btDispatcher *dispatcher)
+{
+  cellEntries.resize(0);
+  oversizedProxies.resize(0);
+
+  if(proxies.size() == 0) {
+    return;
+  }
+
+  boundsMin = proxies[0]->m_aabbMin;
+  boundsMax = proxies[0]->m_aabbMax;
+
+  I32 minCell[3], maxCell[3];
+  for(int i = 0; i < proxies.size(); ++i) {
+    EvGridProxy *proxy = proxies[i];
+    boundsMin.setMin(proxy->m_aabbMin);
+    boundsMax.setMax(proxy->m_aabbMax);
+
+    if(!cellRange(proxy, minCell, maxCell)) {
+      oversizedProxies.push_back(i);
+      continue;
+    }
+    I64 cellCount = (I64)(maxCell[0] - minCell[0] + 1) *
+                    (I64)(maxCell[1] - minCell[1] + 1) *
+                    (I64)(maxCell[2] - minCell[2] + 1);
+    if(cellCount > MAX_PROXY_CELLS) {
+      oversizedProxies.push_back(i);
+      continue;
+    }
+
+    for(I32 x = minCell[0]; x <= maxCell[0]; ++x) {
+      for(I32 y = minCell[1]; y <= maxCell[1]; ++y) {
+        for(I32 z = minCell[2]; z <= maxCell[2]; ++z) {
+          CellEntry entry = { cellKey(x, y, z), i };
+          cellEntries.push_back(entry);
+        }
+      }
+    }
+  }
+
+  cellEntries.quickSort([](const CellEntry &a, const CellEntry &b) { return a < b; });
+
+  I32 minCell0[3], maxCell0[3], minCell1[3], maxCell1[3];
+  for(int begin = 0; begin < cellEntries.size();) {
+    int end = begin + 1;
+    while(end < cellEntries.size() && cellEntries[end].cell == cellEntries[begin].cell) {
+      ++end;
+    }
+
+    for(int a = begin; a < end; ++a) {
+      EvGridProxy *proxy0 = proxies[cellEntries[a].proxy];
+      cellRange(proxy0, minCell0, maxCell0);
+      for(int b = a + 1; b < end; ++b) {
+        EvGridProxy *proxy1 = proxies[cellEntries[b].proxy];
+        cellRange(proxy1, minCell1, maxCell1);
+
+        // Only test the pair in the lowest cell both proxies cover
+        U64 firstShared = cellKey(
+            btMax(minCell0[0], minCell1[0]),
+            btMax(minCell0[1], minCell1[1]),
+            btMax(minCell0[2], minCell1[2]));
+        if(firstShared == cellEntries[begin].cell) {
+          testPair(proxy0, proxy1);
+        }
+      }
+    }
+
+    begin = end;
+  }
+
+  for(int i = 0; i < oversizedProxies.size(); ++i) {
+    EvGridProxy *oversized = proxies[oversizedProxies[i]];
+    for(int j = 0; j < proxies.size(); ++j) {
+      // Pairs of two oversized proxies are tested once
+      if(j == oversizedProxies[i] || (j < oversizedProxies[i] && oversizedProxies.findLinearSearch(j) != oversizedProxies.size())) {
+        continue;
+      }
+      testPair(oversized, proxies[j]);
+    }
+  }
+
+  RemoveSeparatedPairsCallback removeSeparated;
+  pairCache->processAllOverlappingPairs(&removeSeparated, dispatcher);
+}
+
+void
+EvGridBroadphase::getBroadphaseAabb(
+    btVector3 &aabbMin,
+    btVector3 &aabbMax) const
+{
+  aabbMin = boundsMin;
+  aabbMax = boundsMax;
+}
+
+void
+EvGridBroadphase::printStats()
+{
+  ev_log_info("EvGridBroadphase: %d proxies, %d cell entries, %d oversized, %d pairs",
+      proxies.size(), cellEntries.size(), oversizedProxies.size(), pairCache->getNumOverlappingPairs());
+}
@@ -0,0 +1,147 @@
+#include <EvHeightfieldShape.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static PHY_ScalarType
+heightmapScalarType(
+    U32 dataType)
+{
+  switch(dataType) {
+    case EV_HEIGHTMAP_U8:
+      return PHY_UCHAR;
+    case EV_HEIGHTMAP_I16:
+      return PHY_SHORT;
+    default:
+      return PHY_FLOAT;
+  }
+}
+
+static U64
+heightmapSampleSize(
+    U32 dataType)
+{
+  switch(dataType) {
+    case EV_HEIGHTMAP_U8:
+      return sizeof(U8);
+    case EV_HEIGHTMAP_I16:
+      return sizeof(I16);
+    case EV_HEIGHTMAP_F32:
+      return sizeof(F32);
+    default:
+      return 0;
+  }
+}
+
+EvHeightfieldShape::EvHeightfieldShape(
+    const EvHeightmapHeader *header,
+    void *mappedData,
+    U64 mappedSize,
+    void *fileHandle,
+    void *mappingHandle)
+  : btHeightfieldTerrainShape(
+      header->width,
+      header->length,
+      header + 1,
+      header->heightScale,
+      header->minHeight,
+      header->maxHeight,
+      1,
+      heightmapScalarType(header->dataType),
+      false)
+  , mappedData(mappedData)
+  , mappedSize(mappedSize)
+  , fileHandle(fileHandle)
+  , mappingHandle(mappingHandle)
+{
+}
+
+EvHeightfieldShape::~EvHeightfieldShape()
+{
+#if defined(_WIN32)
+  UnmapViewOfFile(mappedData);
+  CloseHandle(static_cast<HANDLE>(mappingHandle));
+  CloseHandle(static_cast<HANDLE>(fileHandle));
+#else
+  munmap(mappedData, mappedSize);
+#endif
+}
+
+EvHeightfieldShape *
+EvHeightfieldShape::fromFile(
+    const char *path)
+{
+  void *data = nullptr;
+  U64 size = 0;
+  void *fileHandle = nullptr;
+  void *mappingHandle = nullptr;
+
+#if defined(_WIN32)
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  if(file == INVALID_HANDLE_VALUE) {
+    return nullptr;
+  }
+  LARGE_INTEGER fileSize;
+  HANDLE mapping = NULL;
+  if(GetFileSizeEx(file, &fileSize)) {
+    mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  }
+  if(mapping == NULL) {
+    CloseHandle(file);
+    return nullptr;
+  }
+  data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  if(data == NULL) {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return nullptr;
+  }
+  size = fileSize.QuadPart;
+  fileHandle = file;
+  mappingHandle = mapping;
+#else
+  int fd = open(path, O_RDONLY);
+  if(fd < 0) {
+    return nullptr;
+  }
+  struct stat fileStat;
+  if(fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+    close(fd);
+    return nullptr;
+  }
+  size = fileStat.st_size;
+  data = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping keeps the file alive
+  close(fd);
+  if(data == MAP_FAILED) {
+    return nullptr;
+  }
+#endif
+
+  const EvHeightmapHeader *header = static_cast<const EvHeightmapHeader*>(data);
+  U64 sampleSize = size >= sizeof(EvHeightmapHeader) ? heightmapSampleSize(header->dataType) : 0;
+  bool valid = sampleSize > 0 &&
+    header->magic == EV_HEIGHTMAP_MAGIC &&
+    header->version == EV_HEIGHTMAP_VERSION &&
+    header->width > 1 && header->length > 1 &&
+    size >= sizeof(EvHeightmapHeader) + (U64)header->width * header->length * sampleSize;
+
+  if(!valid) {
+#if defined(_WIN32)
+    UnmapViewOfFile(data);
+    CloseHandle(static_cast<HANDLE>(mappingHandle));
+    CloseHandle(static_cast<HANDLE>(fileHandle));
+#else
+    munmap(data, size);
+#endif
+    return nullptr;
+  }
+
+  return new EvHeightfieldShape(header, data, size, fileHandle, mappingHandle);
+}
@@ -0,0 +1,188 @@
+#include <EvMeshBuilder.h>
+
+#define MESH_BUILD_QUEUE_PER_THREAD 2
+
+EvMeshBuildJob::EvMeshBuildJob(
+    const char *path)
+  : path(path)
+  , state(QUEUED)
+  , mesh(nullptr)
+  , shape(nullptr)
+{
+}
+
+EvMeshBuildJob::~EvMeshBuildJob()
+{
+  delete shape;
+  delete mesh;
+}
+
+EvPendingMeshShape::EvPendingMeshShape(
+    std::shared_ptr<EvMeshBuildJob> job)
+  : job(std::move(job))
+{
+}
+
+bool
+EvPendingMeshShape::isReady() const
+{
+  int state = job->state.load(std::memory_order_acquire);
+  return state == EvMeshBuildJob::DONE || state == EvMeshBuildJob::FAILED;
+}
+
+btCollisionShape *
+EvPendingMeshShape::getShape() const
+{
+  if(job->state.load(std::memory_order_acquire) != EvMeshBuildJob::DONE) {
+    return nullptr;
+  }
+  return job->shape;
+}
+
+const char *
+EvPendingMeshShape::getPath() const
+{
+  return job->path.c_str();
+}
+
+EvMeshBuilder::EvMeshBuilder(
+    LoadFunc load,
+    U32 maxConcurrentBuilds)
+  : load(load)
+  , threadCount(maxConcurrentBuilds > 0 ? maxConcurrentBuilds : 1)
+  , outstanding(0)
+  , stopping(false)
+{
+}
+
+EvMeshBuilder::~EvMeshBuilder()
+{
+  {
+    std::lock_guard<std::mutex> guard(queueMtx);
+    stopping = true;
+    // Objects waiting on these give up on them instead of waiting forever
+    for(std::shared_ptr<EvMeshBuildJob> &job : queue) {
+      job->state.store(EvMeshBuildJob::FAILED, std::memory_order_release);
+    }
+    queue.clear();
+  }
+  queueCond.notify_all();
+  slotCond.notify_all();
+
+  for(std::thread &thread : threads) {
+    thread.join();
+  }
+}
+
+EvPendingMeshShape *
+EvMeshBuilder::request(
+    const char *path)
+{
+  std::shared_ptr<EvMeshBuildJob> job = std::make_shared<EvMeshBuildJob>(path);
+
+  // Reserve the slot before loading, so that no more than the bound of
+  // loaded meshes ever waits for a thread
+  {
+    std::unique_lock<std::mutex> lock(queueMtx);
+    slotCond.wait(lock, [this]() { return stopping || outstanding < threadCount * MESH_BUILD_QUEUE_PER_THREAD; });
+    if(stopping) {
+      job->state.store(EvMeshBuildJob::FAILED, std::memory_order_release);
+      return new EvPendingMeshShape(job);
+    }
+    outstanding++;
+  }
+
+  job->mesh = new btTriangleMesh();
+  if(!load(path, job->mesh) || job->mesh->getNumTriangles() == 0) {
+    job->state.store(EvMeshBuildJob::FAILED, std::memory_order_release);
+    {
+      std::lock_guard<std::mutex> guard(queueMtx);
+      outstanding--;
+    }
+    slotCond.notify_one();
+    return new EvPendingMeshShape(job);
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(queueMtx);
+    if(stopping) {
+      job->state.store(EvMeshBuildJob::FAILED, std::memory_order_release);
+      return new EvPendingMeshShape(job);
+    }
+    queue.push_back(job);
+    // Threads are only started once something is built asynchronously
+    if(threads.empty()) {
+      for(U32 i = 0; i < threadCount; ++i) {
+        threads.emplace_back(&EvMeshBuilder::work, this, i);
+      }
+    }
+  }
+  queueCond.notify_one();
+
+  return new EvPendingMeshShape(job);
+}
+
+void
+EvMeshBuilder::setMaxConcurrentBuilds(
+    U32 count)
+{
+  std::vector<std::thread> leaving;
+  {
+    std::lock_guard<std::mutex> guard(queueMtx);
+    threadCount = count > 0 ? count : 1;
+    // Not started yet, the next request starts the new count
+    if(threads.empty()) {
+      return;
+    }
+    while(threads.size() > threadCount) {
+      leaving.push_back(std::move(threads.back()));
+      threads.pop_back();
+    }
+    while(threads.size() < threadCount) {
+      threads.emplace_back(&EvMeshBuilder::work, this, (U32)threads.size());
+    }
+  }
+  queueCond.notify_all();
+  // A larger pool also allows a longer queue
+  slotCond.notify_all();
+
+  for(std::thread &thread : leaving) {
+    thread.join();
+  }
+}
+
+void
+EvMeshBuilder::work(
+    U32 index)
+{
+  while(true) {
+    std::shared_ptr<EvMeshBuildJob> job;
+    {
+      std::unique_lock<std::mutex> lock(queueMtx);
+      queueCond.wait(lock, [this, index]() { return stopping || index >= threadCount || !queue.empty(); });
+      if(stopping) {
+        return;
+      }
+      if(index >= threadCount) {
+        // The pool shrank. A request may have woken this thread instead of
+        // one that stays, so pass the wake-up on.
+        lock.unlock();
+        queueCond.notify_all();
+        return;
+      }
+      job = queue.front();
+      queue.pop_front();
+      outstanding--;
+    }
+    slotCond.notify_one();
+
+    // Nobody is waiting for this mesh anymore
+    if(job.use_count() == 1) {
+      continue;
+    }
+
+    job->state.store(EvMeshBuildJob::BUILDING, std::memory_order_relaxed);
+    job->shape = new btBvhTriangleMeshShape(job->mesh, true);
+    job->state.store(EvMeshBuildJob::DONE, std::memory_order_release);
+  }
+}
@@ -1,6 +1,10 @@
 #include <EvMotionState.h>
+#include <EvCapture.h>
+#include <EvGameStub.h>
 #include <evol/common/ev_log.h>
 
+#include <cstring>
+
 #define bt2evVec3(v) {{  v.x(), v.y(), v.z() }}
 #define bt2evQuat(q) {{  q.x(), q.y(), q.z(), q.w() }}
 
@@ -11,6 +15,7 @@ EvMotionState::EvMotionState(
     btVector3* graphicsVec,
     const btTransform& startTransform,
     const btTransform& centerOfMassOffset)
+  : polled(false)
 {
   mod = GameModuleRef();
 }
@@ -18,15 +23,65 @@ EvMotionState::EvMotionState(
 
 void EvMotionState::getWorldTransform(btTransform & centerOfMassWorldTrans) const
 {
+  if(EvGameStub::isActive()) {
+    EvGameStub::getTransform(gameScene, gameObject, centerOfMassWorldTrans);
+    return;
+  }
+
   const Matrix4x4 *objectTransform = Object->getWorldTransform(gameScene, gameObject);
   centerOfMassWorldTrans.setFromOpenGLMatrix(reinterpret_cast<const btScalar*>(*objectTransform));
+
+  if(EvCapture::isActive()) {
+    EvCapture::recordTransform(gameScene, gameObject, reinterpret_cast<const F32*>(*objectTransform));
+  }
+}
+
+bool EvMotionState::pollWorldTransform(btTransform & centerOfMassWorldTrans)
+{
+  F32 stubTransform[16];
+  const F32 *matrix;
+  if(EvGameStub::isActive()) {
+    EvGameStub::getMatrix(gameScene, gameObject, stubTransform);
+    matrix = stubTransform;
+  } else {
+    matrix = reinterpret_cast<const F32*>(*Object->getWorldTransform(gameScene, gameObject));
+  }
+
+  if(polled && memcmp(matrix, polledTransform, sizeof(polledTransform)) == 0) {
+    return false;
+  }
+  memcpy(polledTransform, matrix, sizeof(polledTransform));
+  polled = true;
+
+  centerOfMassWorldTrans.setFromOpenGLMatrix(reinterpret_cast<const btScalar*>(matrix));
+
+  // Only changes are recorded. The stub keeps the last recorded transform,
+  // so a replay sees the same changes.
+  if(EvCapture::isActive() && !EvGameStub::isActive()) {
+    EvCapture::recordTransform(gameScene, gameObject, matrix);
+  }
+  return true;
 }
 
 void EvMotionState::setWorldTransform(const btTransform & centerOfMassWorldTrans)
 {
+  // Nothing reads the results back during a replay
+  if(EvGameStub::isActive()) {
+    return;
+  }
+
   const btVector3& pos = centerOfMassWorldTrans.getOrigin();
   btQuaternion rot = centerOfMassWorldTrans.getRotation();
 
   Object->setPosition(gameScene, gameObject, bt2evVec3(pos));
   Object->setRotation(gameScene, gameObject, bt2evQuat(rot));
 }
+
+void EvMotionState::setWorldPosition(const btVector3 & position)
+{
+  if(EvGameStub::isActive()) {
+    return;
+  }
+
+  Object->setPosition(gameScene, gameObject, bt2evVec3(position));
+}
@@ -0,0 +1,577 @@
+#include <evol/common/ev_types.h>
+#include <evol/common/ev_log.h>
+
+#define TYPE_MODULE evmod_physics
+#include <evol/meta/type_import.h>
+#define TYPE_MODULE evmod_game
+#include <evol/meta/type_import.h>
+
+#include <physics_api.h>
+
+#include <EvReplay.h>
+#include <EvCapture.h>
+#include <EvGameStub.h>
+
+#include <vector>
+
+U64
+EvReplay::world(
+    U64 recorded) const
+{
+  auto replayed = worlds.find(recorded);
+  return replayed != worlds.end() ? replayed->second : ev_physicsworld_invalidhandle();
+}
+
+void *
+EvReplay::object(
+    void *recorded) const
+{
+  auto replayed = objects.find(recorded);
+  return replayed != objects.end() ? replayed->second : nullptr;
+}
+
+bool
+EvReplay::run(
+    const char *path,
+    Stats &stats)
+{
+  stats = {};
+
+  EvCaptureReader reader;
+  if(!reader.open(path)) {
+    return false;
+  }
+
+  const PhysicsWorldHandle invalidWorld = ev_physicsworld_invalidhandle();
+  std::vector<void*> handles;
+  std::vector<Vec3> moves;
+  std::vector<ConstraintInfo> constraintInfos;
+  std::vector<VehicleWheel> vehicleWheels;
+  std::vector<VehicleControls> vehicleControls;
+
+  EvGameStub::setActive(true);
+
+  EvCaptureOp op;
+  while(reader.next(op)) {
+    stats.recordCount++;
+    bool replayed = true;
+
+    switch(op) {
+      case EV_CAPTURE_SCENE_WORLD: {
+        U64 scene = reader.get<U64>();
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        EvGameStub::setSceneWorld(scene, world_handle);
+        break;
+      }
+      case EV_CAPTURE_OBJECT_TRANSFORM: {
+        U64 scene = reader.get<U64>();
+        U64 gameObject = reader.get<U64>();
+        EvCaptureMatrix transform = reader.get<EvCaptureMatrix>();
+        EvGameStub::setTransform(scene, gameObject, transform.m);
+        break;
+      }
+
+      case EV_CAPTURE_WORLD_NEW: {
+        PhysicsWorldInfo info = reader.get<PhysicsWorldInfo>();
+        PhysicsWorldHandle recorded = reader.get<PhysicsWorldHandle>();
+        worlds[recorded] = ev_physicsworld_newworldex(info);
+        break;
+      }
+      case EV_CAPTURE_WORLD_DESTROY: {
+        PhysicsWorldHandle recorded = reader.get<PhysicsWorldHandle>();
+        PhysicsWorldHandle world_handle = world(recorded);
+        if((replayed = world_handle != invalidWorld)) {
+          ev_physicsworld_destroyworld(world_handle);
+          worlds.erase(recorded);
+        }
+        break;
+      }
+      case EV_CAPTURE_WORLD_PROGRESS: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        F32 deltaTime = reader.get<F32>();
+        if((replayed = world_handle != invalidWorld)) {
+          ev_physicsworld_progress(world_handle, deltaTime);
+          F32 stepTimeMs = ev_physicsworld_getstats(world_handle).stepTimeMs;
+          stats.stepCount++;
+          stats.totalStepTimeMs += stepTimeMs;
+          if(stepTimeMs > stats.worstStepTimeMs) {
+            stats.worstStepTimeMs = stepTimeMs;
+          }
+        }
+        break;
+      }
+      case EV_CAPTURE_WORLD_SETSUBSTEPS: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        U32 maxSubSteps = reader.get<U32>();
+        F32 fixedTimeStep = reader.get<F32>();
+        if((replayed = world_handle != invalidWorld)) {
+          ev_physicsworld_setsubsteps(world_handle, maxSubSteps, fixedTimeStep);
+        }
+        break;
+      }
+      case EV_CAPTURE_WORLD_SETSOLVERPARAMS: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        PhysicsSolverParams params = reader.get<PhysicsSolverParams>();
+        if((replayed = world_handle != invalidWorld)) {
+          ev_physicsworld_setsolverparams(world_handle, params);
+        }
+        break;
+      }
+      case EV_CAPTURE_WORLD_FREEZESTATICS: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        if((replayed = world_handle != invalidWorld)) {
+          ev_physicsworld_freezestatics(world_handle);
+        }
+        break;
+      }
+      // Anchor ids are handed out in order per world, so replaying the same
+      // calls gives out the same ids
+      case EV_CAPTURE_WORLD_ADDANCHOR: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        Vec3 position = reader.get<Vec3>();
+        if((replayed = world_handle != invalidWorld)) {
+          ev_physicsworld_addanchor(world_handle, position);
+        }
+        break;
+      }
+      case EV_CAPTURE_WORLD_SETANCHORPOSITION: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        U32 anchor = reader.get<U32>();
+        Vec3 position = reader.get<Vec3>();
+        if((replayed = world_handle != invalidWorld)) {
+          ev_physicsworld_setanchorposition(world_handle, anchor, position);
+        }
+        break;
+      }
+      case EV_CAPTURE_WORLD_REMOVEANCHOR: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        U32 anchor = reader.get<U32>();
+        if((replayed = world_handle != invalidWorld)) {
+          ev_physicsworld_removeanchor(world_handle, anchor);
+        }
+        break;
+      }
+      case EV_CAPTURE_WORLD_SETSTREAMINGRADIUS: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        F32 radius = reader.get<F32>();
+        if((replayed = world_handle != invalidWorld)) {
+          ev_physicsworld_setstreamingradius(world_handle, radius);
+        }
+        break;
+      }
+      case EV_CAPTURE_WORLD_SETLODDISTANCES: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        F32 reducedDistance = reader.get<F32>();
+        F32 ballisticDistance = reader.get<F32>();
+        U32 reducedInterval = reader.get<U32>();
+        if((replayed = world_handle != invalidWorld)) {
+          ev_physicsworld_setloddistances(world_handle, reducedDistance, ballisticDistance, reducedInterval);
+        }
+        break;
+      }
+      case EV_CAPTURE_WORLD_SETCONTACTREPORT: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        U32 capacity = reader.get<U32>();
+        F32 minImpulse = reader.get<F32>();
+        if((replayed = world_handle != invalidWorld)) {
+          ev_physicsworld_setcontactreport(world_handle, capacity, minImpulse);
+        }
+        break;
+      }
+      case EV_CAPTURE_WORLD_SETDETERMINISTIC: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        bool deterministic = reader.get<bool>();
+        if((replayed = world_handle != invalidWorld)) {
+          ev_physicsworld_setdeterministic(world_handle, deterministic);
+        }
+        break;
+      }
+
+      case EV_CAPTURE_SHAPE_BOX: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        Vec3 halfExtents = reader.get<Vec3>();
+        CollisionShapeHandle recorded = reader.get<CollisionShapeHandle>();
+        if((replayed = world_handle != invalidWorld)) {
+          objects[recorded] = _ev_collisionshape_newbox(world_handle, halfExtents);
+        }
+        break;
+      }
+      case EV_CAPTURE_SHAPE_SPHERE: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        F32 radius = reader.get<F32>();
+        CollisionShapeHandle recorded = reader.get<CollisionShapeHandle>();
+        if((replayed = world_handle != invalidWorld)) {
+          objects[recorded] = _ev_collisionshape_newsphere(world_handle, radius);
+        }
+        break;
+      }
+      case EV_CAPTURE_SHAPE_CAPSULE: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        F32 radius = reader.get<F32>();
+        F32 height = reader.get<F32>();
+        CollisionShapeHandle recorded = reader.get<CollisionShapeHandle>();
+        if((replayed = world_handle != invalidWorld)) {
+          objects[recorded] = _ev_collisionshape_newcapsule(world_handle, radius, height);
+        }
+        break;
+      }
+      case EV_CAPTURE_SHAPE_MESH:
+      case EV_CAPTURE_SHAPE_MESHASYNC: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        const char *meshPath = reader.getString();
+        CollisionShapeHandle recorded = reader.get<CollisionShapeHandle>();
+        if((replayed = world_handle != invalidWorld && meshPath != nullptr)) {
+          objects[recorded] = op == EV_CAPTURE_SHAPE_MESH
+            ? _ev_collisionshape_newmesh(world_handle, meshPath)
+            : _ev_collisionshape_newmeshasync(world_handle, meshPath);
+        }
+        break;
+      }
+      case EV_CAPTURE_SHAPE_CONVEXHULL: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        const char *meshPath = reader.getString();
+        U32 maxVertices = reader.get<U32>();
+        CollisionShapeHandle recorded = reader.get<CollisionShapeHandle>();
+        if((replayed = world_handle != invalidWorld && meshPath != nullptr)) {
+          objects[recorded] = _ev_collisionshape_newconvexhull(world_handle, meshPath, maxVertices);
+        }
+        break;
+      }
+      case EV_CAPTURE_SHAPE_COMPOUND: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        U32 childCount;
+        const CollisionShapeHandle *children = reader.getArray<CollisionShapeHandle>(childCount);
+        U32 transformCount;
+        const Matrix4x4 *transforms = reader.getArray<Matrix4x4>(transformCount);
+        CollisionShapeHandle recorded = reader.get<CollisionShapeHandle>();
+
+        handles.clear();
+        for(U32 i = 0; i < childCount; i++) {
+          handles.push_back(object(children[i]));
+        }
+        if((replayed = world_handle != invalidWorld && transformCount == childCount)) {
+          objects[recorded] = _ev_collisionshape_newcompound(world_handle,
+              handles.size() > 0 ? &handles[0] : nullptr,
+              const_cast<Matrix4x4*>(transforms), childCount);
+        }
+        break;
+      }
+      case EV_CAPTURE_SHAPE_DECOMPOSEDMESH: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        const char *meshPath = reader.getString();
+        U32 maxHulls = reader.get<U32>();
+        U32 maxVerticesPerHull = reader.get<U32>();
+        CollisionShapeHandle recorded = reader.get<CollisionShapeHandle>();
+        if((replayed = world_handle != invalidWorld && meshPath != nullptr)) {
+          objects[recorded] = _ev_collisionshape_newdecomposedmesh(world_handle, meshPath, maxHulls, maxVerticesPerHull);
+        }
+        break;
+      }
+      case EV_CAPTURE_SHAPE_HEIGHTFIELD: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        const char *heightmapPath = reader.getString();
+        Vec3 scale = reader.get<Vec3>();
+        CollisionShapeHandle recorded = reader.get<CollisionShapeHandle>();
+        if((replayed = world_handle != invalidWorld && heightmapPath != nullptr)) {
+          objects[recorded] = _ev_collisionshape_newheightfield(world_handle, heightmapPath, scale);
+        }
+        break;
+      }
+      case EV_CAPTURE_SHAPE_DESTROY: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        CollisionShapeHandle recorded = reader.get<CollisionShapeHandle>();
+        CollisionShapeHandle shape = object(recorded);
+        if((replayed = world_handle != invalidWorld && shape != nullptr)) {
+          _ev_collisionshape_destroy(world_handle, shape);
+          objects.erase(recorded);
+        }
+        break;
+      }
+      case EV_CAPTURE_SHAPE_SETCACHEDIRECTORY: {
+        const char *cachePath = reader.getString();
+        if((replayed = cachePath != nullptr)) {
+          _ev_collisionshape_setcachedirectory(cachePath);
+        }
+        break;
+      }
+
+      case EV_CAPTURE_RIGIDBODY_NEW: {
+        U64 scene = reader.get<U64>();
+        U64 entt = reader.get<U64>();
+        RigidbodyInfo info = reader.get<RigidbodyInfo>();
+        RigidbodyHandle recorded = reader.get<RigidbodyHandle>();
+        info.collisionShape = object(info.collisionShape);
+        if((replayed = EvGameStub::getSceneWorld(scene) != invalidWorld && info.collisionShape != nullptr)) {
+          objects[recorded] = _ev_rigidbody_new((GameScene)scene, entt, info);
+        }
+        break;
+      }
+      case EV_CAPTURE_RIGIDBODY_DESTROY: {
+        U64 scene = reader.get<U64>();
+        RigidbodyHandle recorded = reader.get<RigidbodyHandle>();
+        RigidbodyHandle rb = object(recorded);
+        if((replayed = EvGameStub::getSceneWorld(scene) != invalidWorld && rb != nullptr)) {
+          _ev_rigidbody_destroy((GameScene)scene, rb);
+          objects.erase(recorded);
+        }
+        break;
+      }
+      case EV_CAPTURE_RIGIDBODY_DESTROYBATCH: {
+        U64 scene = reader.get<U64>();
+        U32 count;
+        const RigidbodyHandle *recorded = reader.getArray<RigidbodyHandle>(count);
+        if((replayed = EvGameStub::getSceneWorld(scene) != invalidWorld && count > 0)) {
+          handles.clear();
+          for(U32 i = 0; i < count; i++) {
+            handles.push_back(object(recorded[i]));
+            objects.erase(recorded[i]);
+          }
+          _ev_rigidbody_destroybatch((GameScene)scene, &handles[0], count);
+        }
+        break;
+      }
+      case EV_CAPTURE_RIGIDBODY_SETPOSITION:
+      case EV_CAPTURE_RIGIDBODY_SETVELOCITY:
+      case EV_CAPTURE_RIGIDBODY_SETROTATIONEULER:
+      case EV_CAPTURE_RIGIDBODY_ADDFORCE: {
+        RigidbodyHandle rb = object(reader.get<RigidbodyHandle>());
+        Vec3 value = reader.get<Vec3>();
+        if(!(replayed = rb != nullptr)) {
+          break;
+        }
+        switch(op) {
+          case EV_CAPTURE_RIGIDBODY_SETPOSITION: _ev_rigidbody_setposition(rb, value); break;
+          case EV_CAPTURE_RIGIDBODY_SETVELOCITY: _ev_rigidbody_setvelocity(rb, value); break;
+          case EV_CAPTURE_RIGIDBODY_SETROTATIONEULER: _ev_rigidbody_setrotationeuler(rb, value); break;
+          default: _ev_rigidbody_addforce(rb, value); break;
+        }
+        break;
+      }
+
+      case EV_CAPTURE_CHARACTER_NEW: {
+        U64 scene = reader.get<U64>();
+        U64 entt = reader.get<U64>();
+        CharacterInfo info = reader.get<CharacterInfo>();
+        CharacterHandle recorded = reader.get<CharacterHandle>();
+        info.collisionShape = object(info.collisionShape);
+        if((replayed = EvGameStub::getSceneWorld(scene) != invalidWorld && info.collisionShape != nullptr)) {
+          objects[recorded] = _ev_character_new((GameScene)scene, entt, info);
+        }
+        break;
+      }
+      case EV_CAPTURE_CHARACTER_DESTROY: {
+        U64 scene = reader.get<U64>();
+        CharacterHandle recorded = reader.get<CharacterHandle>();
+        CharacterHandle character = object(recorded);
+        if((replayed = EvGameStub::getSceneWorld(scene) != invalidWorld && character != nullptr)) {
+          _ev_character_destroy((GameScene)scene, character);
+          objects.erase(recorded);
+        }
+        break;
+      }
+      case EV_CAPTURE_CHARACTER_MOVE: {
+        CharacterHandle character = object(reader.get<CharacterHandle>());
+        Vec3 desiredMove = reader.get<Vec3>();
+        F32 deltaTime = reader.get<F32>();
+        if((replayed = character != nullptr)) {
+          _ev_character_move(character, desiredMove, deltaTime);
+        }
+        break;
+      }
+      case EV_CAPTURE_CHARACTER_MOVEBATCH: {
+        U32 count;
+        const CharacterHandle *characters = reader.getArray<CharacterHandle>(count);
+        U32 moveCount;
+        const Vec3 *desiredMoves = reader.getArray<Vec3>(moveCount);
+        F32 deltaTime = reader.get<F32>();
+
+        // Characters that can't be mapped are left out of the batch
+        handles.clear();
+        moves.clear();
+        for(U32 i = 0; i < count && i < moveCount; i++) {
+          CharacterHandle character = object(characters[i]);
+          if(character != nullptr) {
+            handles.push_back(character);
+            moves.push_back(desiredMoves[i]);
+          }
+        }
+        if((replayed = handles.size() > 0)) {
+          _ev_character_movebatch(&handles[0], &moves[0], U32(handles.size()), deltaTime);
+        }
+        break;
+      }
+      case EV_CAPTURE_CHARACTER_JUMP: {
+        CharacterHandle character = object(reader.get<CharacterHandle>());
+        if((replayed = character != nullptr)) {
+          _ev_character_jump(character);
+        }
+        break;
+      }
+
+      case EV_CAPTURE_VEHICLE_NEW: {
+        U64 scene = reader.get<U64>();
+        RigidbodyHandle chassis = object(reader.get<RigidbodyHandle>());
+        VehicleInfo info = reader.get<VehicleInfo>();
+        U32 wheelCount;
+        const VehicleWheel *wheels = reader.getArray<VehicleWheel>(wheelCount);
+        vehicleWheels.assign(wheels, wheels + wheelCount);
+        VehicleHandle recorded = reader.get<VehicleHandle>();
+        if((replayed = EvGameStub::getSceneWorld(scene) != invalidWorld && chassis != nullptr && wheelCount > 0)) {
+          objects[recorded] = _ev_vehicle_new((GameScene)scene, chassis, info, &vehicleWheels[0], wheelCount);
+        }
+        break;
+      }
+      case EV_CAPTURE_VEHICLE_DESTROY: {
+        U64 scene = reader.get<U64>();
+        VehicleHandle recorded = reader.get<VehicleHandle>();
+        VehicleHandle vehicle = object(recorded);
+        if((replayed = EvGameStub::getSceneWorld(scene) != invalidWorld && vehicle != nullptr)) {
+          _ev_vehicle_destroy((GameScene)scene, vehicle);
+          objects.erase(recorded);
+        }
+        break;
+      }
+      case EV_CAPTURE_VEHICLE_SETCONTROLS: {
+        VehicleHandle vehicle = object(reader.get<VehicleHandle>());
+        VehicleControls controls = reader.get<VehicleControls>();
+        if((replayed = vehicle != nullptr)) {
+          _ev_vehicle_setcontrols(vehicle, controls);
+        }
+        break;
+      }
+      case EV_CAPTURE_VEHICLE_SETCONTROLSBATCH: {
+        U32 count;
+        const VehicleHandle *vehicles = reader.getArray<VehicleHandle>(count);
+        U32 controlsCount;
+        const VehicleControls *controls = reader.getArray<VehicleControls>(controlsCount);
+
+        // Vehicles that can't be mapped are left out of the batch
+        handles.clear();
+        vehicleControls.clear();
+        for(U32 i = 0; i < count && i < controlsCount; i++) {
+          VehicleHandle vehicle = object(vehicles[i]);
+          if(vehicle != nullptr) {
+            handles.push_back(vehicle);
+            vehicleControls.push_back(controls[i]);
+          }
+        }
+        if((replayed = handles.size() > 0)) {
+          _ev_vehicle_setcontrolsbatch(&handles[0], &vehicleControls[0], U32(handles.size()));
+        }
+        break;
+      }
+
+      case EV_CAPTURE_CONSTRAINT_NEWBATCH: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        U32 count;
+        const ConstraintInfo *infos = reader.getArray<ConstraintInfo>(count);
+        constraintInfos.assign(infos, infos + count);
+        U32 resultCount;
+        const ConstraintHandle *recorded = reader.getArray<ConstraintHandle>(resultCount);
+        if(!(replayed = world_handle != invalidWorld && count > 0 && resultCount == count)) {
+          break;
+        }
+
+        for(U32 i = 0; i < count; i++) {
+          constraintInfos[i].bodyA = object(constraintInfos[i].bodyA);
+          constraintInfos[i].bodyB = object(constraintInfos[i].bodyB);
+        }
+        handles.resize(count);
+        _ev_constraint_newbatch(world_handle, &constraintInfos[0], count, &handles[0]);
+        for(U32 i = 0; i < count; i++) {
+          objects[recorded[i]] = handles[i];
+        }
+        break;
+      }
+      case EV_CAPTURE_CONSTRAINT_DESTROY: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        ConstraintHandle recorded = reader.get<ConstraintHandle>();
+        ConstraintHandle constraint = object(recorded);
+        if((replayed = world_handle != invalidWorld && constraint != nullptr)) {
+          _ev_constraint_destroy(world_handle, constraint);
+          objects.erase(recorded);
+        }
+        break;
+      }
+      case EV_CAPTURE_CONSTRAINT_SETENABLED: {
+        ConstraintHandle constraint = object(reader.get<ConstraintHandle>());
+        bool enabled = reader.get<bool>();
+        if((replayed = constraint != nullptr)) {
+          _ev_constraint_setenabled(constraint, enabled);
+        }
+        break;
+      }
+
+      case EV_CAPTURE_RAYTEST: {
+        U64 scene = reader.get<U64>();
+        Vec3 orig = reader.get<Vec3>();
+        Vec3 dir = reader.get<Vec3>();
+        F32 len = reader.get<F32>();
+        if((replayed = EvGameStub::getSceneWorld(scene) != invalidWorld)) {
+          ev_physics_raytest((GameScene)scene, orig, dir, len);
+        }
+        break;
+      }
+
+      case EV_CAPTURE_SOFTBODY_NEWCLOTH: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        const char *meshPath = reader.getString();
+        SoftBodyInfo info = reader.get<SoftBodyInfo>();
+        SoftBodyHandle recorded = reader.get<SoftBodyHandle>();
+        if((replayed = world_handle != invalidWorld && meshPath != nullptr)) {
+          objects[recorded] = _ev_softbody_newcloth(world_handle, meshPath, info);
+        }
+        break;
+      }
+      case EV_CAPTURE_SOFTBODY_DESTROY: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        SoftBodyHandle recorded = reader.get<SoftBodyHandle>();
+        SoftBodyHandle softbody = object(recorded);
+        if((replayed = world_handle != invalidWorld && softbody != nullptr)) {
+          _ev_softbody_destroy(world_handle, softbody);
+          objects.erase(recorded);
+        }
+        break;
+      }
+      case EV_CAPTURE_SOFTBODY_PINVERTEX: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        SoftBodyHandle softbody = object(reader.get<SoftBodyHandle>());
+        U32 vertex = reader.get<U32>();
+        RigidbodyHandle recordedBody = reader.get<RigidbodyHandle>();
+        RigidbodyHandle rigidbody = object(recordedBody);
+        if((replayed = world_handle != invalidWorld && softbody != nullptr
+              && (recordedBody == nullptr || rigidbody != nullptr))) {
+          _ev_softbody_pinvertex(world_handle, softbody, vertex, rigidbody);
+        }
+        break;
+      }
+      case EV_CAPTURE_SOFTBODY_UNPINVERTEX: {
+        PhysicsWorldHandle world_handle = world(reader.get<PhysicsWorldHandle>());
+        SoftBodyHandle softbody = object(reader.get<SoftBodyHandle>());
+        U32 vertex = reader.get<U32>();
+        if((replayed = world_handle != invalidWorld && softbody != nullptr)) {
+          _ev_softbody_unpinvertex(world_handle, softbody, vertex);
+        }
+        break;
+      }
+
+      default:
+        replayed = false;
+        break;
+    }
+
+    if(!replayed) {
+      stats.skippedCount++;
+    }
+  }
+
+  for(auto &replayedWorld : worlds) {
+    ev_physicsworld_destroyworld(replayedWorld.second);
+  }
+  worlds.clear();
+  objects.clear();
+
+  EvGameStub::setActive(false);
+
+  return true;
+}
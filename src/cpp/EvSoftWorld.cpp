@@ -0,0 +1,510 @@
+#include <EvSoftWorld.h>
+
+#include <BulletSoftBody/btSoftBodyHelpers.h>
+
+#include <algorithm>
+#include <cstring>
+
+// Helpers next to the soft world's own thread
+#define SOFT_SOLVER_MAX_HELPERS 3
+
+EvSoftBodySolver::EvSoftBodySolver(
+    U32 helperCount)
+  : generation(0)
+  , busyHelpers(0)
+  , stopping(false)
+  , pass(PREDICT_MOTION)
+  , timeStep(0.f)
+  , nextBody(0)
+{
+  for(U32 i = 0; i < helperCount; ++i) {
+    helpers.emplace_back(&EvSoftBodySolver::work, this);
+  }
+}
+
+EvSoftBodySolver::~EvSoftBodySolver()
+{
+  {
+    std::lock_guard<std::mutex> guard(passMtx);
+    stopping = true;
+  }
+  startCond.notify_all();
+  for(std::thread &helper : helpers) {
+    helper.join();
+  }
+}
+
+void
+EvSoftBodySolver::runBodies()
+{
+  int count = m_softBodySet.size();
+  for(int i = nextBody.fetch_add(1); i < count; i = nextBody.fetch_add(1)) {
+    btSoftBody *body = m_softBodySet[i];
+    if(!body->isActive()) {
+      continue;
+    }
+    switch(pass) {
+      case PREDICT_MOTION: body->predictMotion(timeStep); break;
+      case SOLVE_CONSTRAINTS: body->solveConstraints(); break;
+      case INTEGRATE_MOTION: body->integrateMotion(); break;
+    }
+  }
+}
+
+void
+EvSoftBodySolver::work()
+{
+  U64 seen = 0;
+  while(true) {
+    {
+      std::unique_lock<std::mutex> lock(passMtx);
+      startCond.wait(lock, [this, seen]() { return stopping || generation != seen; });
+      if(stopping) {
+        return;
+      }
+      seen = generation;
+    }
+
+    runBodies();
+
+    {
+      std::lock_guard<std::mutex> guard(passMtx);
+      busyHelpers--;
+    }
+    doneCond.notify_one();
+  }
+}
+
+// Runs on the soft world's thread, which takes bodies along with the helpers
+void
+EvSoftBodySolver::run(
+    Pass pass,
+    btScalar timeStep)
+{
+  if(m_softBodySet.size() == 0) {
+    return;
+  }
+
+  this->pass = pass;
+  this->timeStep = timeStep;
+  nextBody.store(0);
+  if(helpers.empty() || m_softBodySet.size() == 1) {
+    runBodies();
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> guard(passMtx);
+    busyHelpers = helpers.size();
+    generation++;
+  }
+  startCond.notify_all();
+
+  runBodies();
+
+  std::unique_lock<std::mutex> lock(passMtx);
+  doneCond.wait(lock, [this]() { return busyHelpers == 0; });
+}
+
+void
+EvSoftBodySolver::predictMotion(
+    btScalar solverdt)
+{
+  run(PREDICT_MOTION, solverdt);
+}
+
+void
+EvSoftBodySolver::solveConstraints(
+    btScalar solverdt)
+{
+  run(SOLVE_CONSTRAINTS, solverdt);
+}
+
+void
+EvSoftBodySolver::updateSoftBodies()
+{
+  run(INTEGRATE_MOTION, 0.f);
+}
+
+EvSoftWorld::EvSoftWorld(
+    const btVector3 &gravity)
+  : stepping(false)
+  , stopping(false)
+  , timeStep(0.f)
+  , maxSubSteps(0)
+  , fixedTimeStep(0.f)
+{
+  collisionConfiguration = new btSoftBodyRigidBodyCollisionConfiguration();
+  dispatcher = new btCollisionDispatcher(collisionConfiguration);
+  broadphase = new btDbvtBroadphase();
+  constraintSolver = new btSequentialImpulseConstraintSolver();
+  U32 hardwareThreads = std::thread::hardware_concurrency();
+  softBodySolver = new EvSoftBodySolver(std::min<U32>(hardwareThreads > 1 ? hardwareThreads - 1 : 0, SOFT_SOLVER_MAX_HELPERS));
+  world = new btSoftRigidDynamicsWorld(dispatcher, broadphase, constraintSolver, collisionConfiguration, softBodySolver);
+  setGravity(gravity);
+
+  thread = std::thread(&EvSoftWorld::work, this);
+}
+
+EvSoftWorld::~EvSoftWorld()
+{
+  {
+    std::lock_guard<std::mutex> guard(stepMtx);
+    stopping = true;
+  }
+  stepCond.notify_all();
+  thread.join();
+
+  for(int i = 0; i < cloths.size(); ++i) {
+    world->removeSoftBody(cloths[i]->body);
+    delete cloths[i]->body;
+    delete cloths[i];
+  }
+  for(auto &mirror : mirrors) {
+    world->removeCollisionObject(mirror.second);
+    delete mirror.second;
+  }
+
+  delete world;
+  delete softBodySolver;
+  delete constraintSolver;
+  delete broadphase;
+  delete dispatcher;
+  delete collisionConfiguration;
+}
+
+void
+EvSoftWorld::setGravity(
+    const btVector3 &gravity)
+{
+  wait();
+  world->setGravity(gravity);
+  // Soft bodies read gravity from the world info, not the world
+  world->getWorldInfo().m_gravity = gravity;
+}
+
+void
+EvSoftWorld::addStatic(
+    const btCollisionObject *object)
+{
+  if(mirrors.count(object) > 0) {
+    return;
+  }
+
+  btCollisionObject *mirror = new btCollisionObject();
+  mirror->setCollisionShape(const_cast<btCollisionShape*>(object->getCollisionShape()));
+  mirror->setWorldTransform(object->getWorldTransform());
+  mirror->setFriction(object->getFriction());
+  mirror->setRestitution(object->getRestitution());
+  mirror->setCollisionFlags(btCollisionObject::CF_STATIC_OBJECT);
+
+  wait();
+  world->addCollisionObject(mirror,
+      btBroadphaseProxy::StaticFilter,
+      btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter);
+  mirrors[object] = mirror;
+}
+
+void
+EvSoftWorld::updateStatic(
+    const btCollisionObject *object)
+{
+  auto mirror = mirrors.find(object);
+  if(mirror == mirrors.end()) {
+    return;
+  }
+
+  wait();
+  mirror->second->setWorldTransform(object->getWorldTransform());
+  world->updateSingleAabb(mirror->second);
+}
+
+// Pins are only read when a step starts, so dropping them doesn't have to
+// wait for the one in flight
+void
+EvSoftWorld::forgetObject(
+    const btCollisionObject *object)
+{
+  for(int i = 0; i < cloths.size(); ++i) {
+    btAlignedObjectArray<Pin> &pins = cloths[i]->pins;
+    for(int p = 0; p < pins.size(); ++p) {
+      if(pins[p].object == object) {
+        pins[p].object = nullptr;
+        pins[p].offset = object->getWorldTransform()(pins[p].offset);
+      }
+    }
+  }
+
+  auto mirror = mirrors.find(object);
+  if(mirror == mirrors.end()) {
+    return;
+  }
+
+  wait();
+  world->removeCollisionObject(mirror->second);
+  delete mirror->second;
+  mirrors.erase(mirror);
+}
+
+struct WeldKey {
+  U32 bits[3];
+
+  bool operator==(const WeldKey &other) const {
+    return bits[0] == other.bits[0] && bits[1] == other.bits[1] && bits[2] == other.bits[2];
+  }
+};
+
+struct WeldKeyHash {
+  size_t operator()(const WeldKey &key) const {
+    return (size_t(key.bits[0]) * 73856093u) ^ (size_t(key.bits[1]) * 19349663u) ^ (size_t(key.bits[2]) * 83492791u);
+  }
+};
+
+EvSoftWorld::Cloth *
+EvSoftWorld::newCloth(
+    const btVector3 *vertices,
+    U32 vertexCount,
+    const U32 *indices,
+    U32 indexCount,
+    const btTransform &transform,
+    const ClothParams &params)
+{
+  Cloth *cloth = new Cloth;
+  cloth->owner = this;
+  cloth->vertexNodes.resize(vertexCount);
+
+  // Asset meshes split vertices along UV and normal seams, which would tear
+  // the cloth apart there
+  std::unordered_map<WeldKey, int, WeldKeyHash> welded;
+  btAlignedObjectArray<btScalar> nodePositions;
+  for(U32 i = 0; i < vertexCount; i++) {
+    F32 position[3] = { F32(vertices[i].x()), F32(vertices[i].y()), F32(vertices[i].z()) };
+    WeldKey key;
+    memcpy(key.bits, position, sizeof(key.bits));
+
+    auto node = welded.find(key);
+    if(node != welded.end()) {
+      cloth->vertexNodes[i] = node->second;
+      continue;
+    }
+    int index = nodePositions.size() / 3;
+    welded[key] = index;
+    cloth->vertexNodes[i] = index;
+    nodePositions.push_back(vertices[i].x());
+    nodePositions.push_back(vertices[i].y());
+    nodePositions.push_back(vertices[i].z());
+  }
+
+  btAlignedObjectArray<int> triangles;
+  for(U32 i = 0; i + 2 < indexCount; i += 3) {
+    if(indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount) {
+      continue;
+    }
+    int a = cloth->vertexNodes[indices[i]];
+    int b = cloth->vertexNodes[indices[i + 1]];
+    int c = cloth->vertexNodes[indices[i + 2]];
+    if(a == b || b == c || a == c) {
+      continue;
+    }
+    triangles.push_back(a);
+    triangles.push_back(b);
+    triangles.push_back(c);
+  }
+
+  if(triangles.size() == 0) {
+    delete cloth;
+    return nullptr;
+  }
+
+  wait();
+
+  cloth->body = btSoftBodyHelpers::CreateFromTriMesh(world->getWorldInfo(), &nodePositions[0], &triangles[0], triangles.size() / 3);
+  btSoftBody *body = cloth->body;
+  body->m_materials[0]->m_kLST = params.stiffness;
+  if(params.bendingStiffness > 0.f) {
+    btSoftBody::Material *bendingMaterial = body->appendMaterial();
+    bendingMaterial->m_kLST = params.bendingStiffness;
+    body->generateBendingConstraints(2, bendingMaterial);
+    body->randomizeConstraints();
+  }
+  body->m_cfg.kDP = params.damping;
+  body->m_cfg.kDF = params.friction;
+  if(params.iterations > 0) {
+    body->m_cfg.piterations = params.iterations;
+  }
+  body->setTotalMass(params.mass, true);
+  body->transform(transform);
+
+  world->addSoftBody(body);
+  cloths.push_back(cloth);
+
+  cloth->positions.resize(size_t(vertexCount) * 3);
+  publish(cloth);
+
+  return cloth;
+}
+
+void
+EvSoftWorld::destroyCloth(
+    Cloth *cloth)
+{
+  wait();
+  world->removeSoftBody(cloth->body);
+  cloths.remove(cloth);
+
+  delete cloth->body;
+  delete cloth;
+}
+
+void
+EvSoftWorld::pinVertex(
+    Cloth *cloth,
+    U32 vertex,
+    const btCollisionObject *object)
+{
+  if(vertex >= cloth->vertexNodes.size()) {
+    return;
+  }
+
+  // Pinning a node again only moves its attachment
+  unpinVertex(cloth, vertex);
+
+  Pin pin;
+  pin.node = cloth->vertexNodes[vertex];
+  pin.mass = cloth->body->getMass(pin.node);
+  pin.object = object;
+
+  const btVector3 &position = cloth->body->m_nodes[pin.node].m_x;
+  pin.offset = object != nullptr ? object->getWorldTransform().invXform(position) : position;
+
+  cloth->body->setMass(pin.node, 0.f);
+  cloth->pins.push_back(pin);
+}
+
+void
+EvSoftWorld::unpinVertex(
+    Cloth *cloth,
+    U32 vertex)
+{
+  if(vertex >= cloth->vertexNodes.size()) {
+    return;
+  }
+
+  wait();
+  int node = cloth->vertexNodes[vertex];
+  btAlignedObjectArray<Pin> &pins = cloth->pins;
+  for(int p = 0; p < pins.size(); ++p) {
+    if(pins[p].node == node) {
+      cloth->body->setMass(node, pins[p].mass);
+      pins.swap(p, pins.size() - 1);
+      pins.pop_back();
+      return;
+    }
+  }
+}
+
+U32
+EvSoftWorld::readVertices(
+    const Cloth *cloth,
+    F32 *out_positions,
+    U32 maxVertices)
+{
+  U32 count = btMin(U32(cloth->vertexNodes.size()), maxVertices);
+  if(count == 0) {
+    return 0;
+  }
+
+  std::lock_guard<std::mutex> guard(cloth->owner->publishMtx);
+  memcpy(out_positions, &cloth->positions[0], sizeof(F32) * 3 * count);
+  return count;
+}
+
+void
+EvSoftWorld::stepAsync(
+    btScalar stepTime,
+    int stepMaxSubSteps,
+    btScalar stepFixedTimeStep)
+{
+  if(cloths.size() == 0) {
+    return;
+  }
+
+  wait();
+  updatePins();
+
+  {
+    std::lock_guard<std::mutex> guard(stepMtx);
+    timeStep = stepTime;
+    maxSubSteps = stepMaxSubSteps;
+    fixedTimeStep = stepFixedTimeStep;
+    stepping = true;
+  }
+  stepCond.notify_all();
+}
+
+void
+EvSoftWorld::wait()
+{
+  std::unique_lock<std::mutex> lock(stepMtx);
+  stepCond.wait(lock, [this]() { return !stepping; });
+}
+
+// Runs between steps with the physics world locked, so the objects'
+// transforms are settled
+void
+EvSoftWorld::updatePins()
+{
+  for(int i = 0; i < cloths.size(); ++i) {
+    btSoftBody *body = cloths[i]->body;
+    btAlignedObjectArray<Pin> &pins = cloths[i]->pins;
+    for(int p = 0; p < pins.size(); ++p) {
+      if(pins[p].object == nullptr) {
+        continue;
+      }
+      btSoftBody::Node &node = body->m_nodes[pins[p].node];
+      node.m_x = pins[p].object->getWorldTransform()(pins[p].offset);
+      node.m_q = node.m_x;
+      node.m_v.setZero();
+    }
+  }
+}
+
+void
+EvSoftWorld::publish(
+    Cloth *cloth)
+{
+  const btSoftBody::tNodeArray &nodes = cloth->body->m_nodes;
+  F32 *positions = &cloth->positions[0];
+
+  std::lock_guard<std::mutex> guard(publishMtx);
+  for(size_t i = 0; i < cloth->vertexNodes.size(); i++) {
+    const btVector3 &position = nodes[cloth->vertexNodes[i]].m_x;
+    positions[i * 3 + 0] = position.x();
+    positions[i * 3 + 1] = position.y();
+    positions[i * 3 + 2] = position.z();
+  }
+}
+
+void
+EvSoftWorld::work()
+{
+  std::unique_lock<std::mutex> lock(stepMtx);
+  while(true) {
+    stepCond.wait(lock, [this]() { return stopping || stepping; });
+    if(stopping) {
+      return;
+    }
+    lock.unlock();
+
+    world->stepSimulation(timeStep, maxSubSteps, fixedTimeStep);
+    // Distance field cells of shapes cloth no longer touches age out
+    world->getWorldInfo().m_sparsesdf.GarbageCollect();
+    for(int i = 0; i < cloths.size(); ++i) {
+      publish(cloths[i]);
+    }
+
+    lock.lock();
+    stepping = false;
+    stepCond.notify_all();
+  }
+}
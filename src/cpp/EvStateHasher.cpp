@@ -0,0 +1,192 @@
+#include <EvStateHasher.h>
+
+#include <BulletDynamics/Dynamics/btRigidBody.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#define XXH_PRIME32_1 2654435761u
+#define XXH_PRIME32_2 2246822519u
+#define XXH_PRIME32_3 3266489917u
+#define XXH_PRIME32_4 668265263u
+
+#define STATE_HASH_SEED 0x45564f4cu // "EVOL"
+
+static inline U32
+rotl32(
+    U32 x,
+    int r)
+{
+  return (x << r) | (x >> (32 - r));
+}
+
+static inline U32
+avalanche32(
+    U32 h)
+{
+  h ^= h >> 15;
+  h *= XXH_PRIME32_2;
+  h ^= h >> 13;
+  h *= XXH_PRIME32_3;
+  h ^= h >> 16;
+  return h;
+}
+
+static inline U32
+encodeScalar(
+    btScalar value,
+    F32 quantum)
+{
+  if(quantum > 0.f) {
+    return static_cast<U32>(static_cast<I32>(std::floor(value / quantum + 0.5f)));
+  }
+  F32 single = static_cast<F32>(value);
+  U32 bits;
+  memcpy(&bits, &single, sizeof(bits));
+  return bits;
+}
+
+void
+EvStateHasher::gather(
+    const btCollisionObject * const *objects,
+    EntityFunc entityOf,
+    int count,
+    F32 quantum)
+{
+  records.resizeNoInitialize(count);
+
+  for(int i = 0; i < count; ++i) {
+    const btCollisionObject *object = objects[i];
+    const btTransform &transform = object->getWorldTransform();
+    btQuaternion rotation = transform.getRotation();
+    // q and -q are the same rotation
+    if(rotation.w() < 0) {
+      rotation = -rotation;
+    }
+
+    btVector3 linearVelocity(0, 0, 0);
+    btVector3 angularVelocity(0, 0, 0);
+    const btRigidBody *body = btRigidBody::upcast(object);
+    if(body != nullptr) {
+      linearVelocity = body->getLinearVelocity();
+      angularVelocity = body->getAngularVelocity();
+    }
+
+    U32 *words = records[i].words;
+    U64 entity = entityOf(object);
+    words[0] = static_cast<U32>(entity);
+    words[1] = static_cast<U32>(entity >> 32);
+    for(int axis = 0; axis < 3; ++axis) {
+      words[2 + axis] = encodeScalar(transform.getOrigin()[axis], quantum);
+      words[9 + axis] = encodeScalar(linearVelocity[axis], quantum);
+      words[12 + axis] = encodeScalar(angularVelocity[axis], quantum);
+    }
+    for(int c = 0; c < 4; ++c) {
+      words[5 + c] = encodeScalar(rotation[c], quantum);
+    }
+    // Reserved, see the activation state note in the header
+    words[15] = 0;
+  }
+}
+
+U64
+EvStateHasher::hashRecords(
+    const Record *records,
+    int count)
+{
+  U32 lanes[4] = {
+    STATE_HASH_SEED + XXH_PRIME32_1 + XXH_PRIME32_2,
+    STATE_HASH_SEED + XXH_PRIME32_2,
+    STATE_HASH_SEED,
+    STATE_HASH_SEED - XXH_PRIME32_1,
+  };
+
+  for(int i = 0; i < count; ++i) {
+    const U32 *words = records[i].words;
+    for(int stripe = 0; stripe < 16; stripe += 4) {
+      for(int lane = 0; lane < 4; ++lane) {
+        lanes[lane] = rotl32(lanes[lane] + words[stripe + lane] * XXH_PRIME32_2, 13) * XXH_PRIME32_1;
+      }
+    }
+  }
+
+  U32 length = static_cast<U32>(count) * sizeof(Record);
+  U32 high = avalanche32(rotl32(lanes[0], 1) + rotl32(lanes[1], 7) + length);
+  U32 low = avalanche32(rotl32(lanes[2], 12) + rotl32(lanes[3], 18) + length * XXH_PRIME32_4);
+  return (static_cast<U64>(high) << 32) | low;
+}
+
+U64
+EvStateHasher::hash(
+    const btCollisionObject * const *objects,
+    EntityFunc entityOf,
+    int count,
+    F32 quantum)
+{
+  if(count == 0) {
+    return hashRecords(nullptr, 0);
+  }
+  gather(objects, entityOf, count, quantum);
+
+  // Entity first; records of objects without one are ordered by content
+  std::sort(&records[0], &records[0] + count, [](const Record &a, const Record &b) {
+    return memcmp(a.words, b.words, sizeof(a.words)) < 0;
+  });
+  return hashRecords(&records[0], count);
+}
+
+U32
+EvStateHasher::hashRegions(
+    const btCollisionObject * const *objects,
+    EntityFunc entityOf,
+    int count,
+    F32 quantum,
+    F32 regionSize,
+    Region *out_regions,
+    U32 maxRegions)
+{
+  if(count == 0 || regionSize <= 0.f) {
+    return 0;
+  }
+  gather(objects, entityOf, count, quantum);
+
+  // Region membership uses the unquantized position, a body right on a
+  // border may still land on different sides on two machines
+  regionRecords.resizeNoInitialize(count);
+  for(int i = 0; i < count; ++i) {
+    const btVector3 &origin = objects[i]->getWorldTransform().getOrigin();
+    I32 x = static_cast<I32>(std::floor(origin.x() / regionSize));
+    I32 z = static_cast<I32>(std::floor(origin.z() / regionSize));
+    // Offset so that packed keys sort like (x, z)
+    regionRecords[i].key = (static_cast<U64>(static_cast<U32>(x) ^ 0x80000000u) << 32) | (static_cast<U32>(z) ^ 0x80000000u);
+    regionRecords[i].hash = hashRecords(&records[i], 1);
+  }
+
+  std::sort(&regionRecords[0], &regionRecords[0] + count, [](const RegionRecord &a, const RegionRecord &b) {
+    return a.key < b.key || (a.key == b.key && a.hash < b.hash);
+  });
+
+  // Object hashes are sorted within a region, so the combined hash doesn't
+  // depend on the order objects were given in
+  U32 regionCount = 0;
+  int begin = 0;
+  while(begin < count) {
+    U64 key = regionRecords[begin].key;
+    U64 hash = 0xcbf29ce484222325ull;
+    int end = begin;
+    for(; end < count && regionRecords[end].key == key; ++end) {
+      hash = (hash ^ regionRecords[end].hash) * 0x100000001b3ull;
+    }
+
+    if(regionCount < maxRegions) {
+      out_regions[regionCount].x = static_cast<I32>(static_cast<U32>(key >> 32) ^ 0x80000000u);
+      out_regions[regionCount].z = static_cast<I32>(static_cast<U32>(key) ^ 0x80000000u);
+      out_regions[regionCount].hash = hash;
+    }
+    regionCount++;
+    begin = end;
+  }
+
+  return regionCount;
+}
@@ -0,0 +1,297 @@
+#include <EvVehicleBatch.h>
+
+#include <BulletCollision/BroadphaseCollision/btDbvtBroadphase.h>
+#include <BulletCollision/CollisionDispatch/btGhostObject.h>
+#include <LinearMath/btThreads.h>
+
+EvVehicleRaycaster::EvVehicleRaycaster()
+  : vehicle(nullptr)
+  , world(nullptr)
+  , cursor(0)
+{}
+
+// Wheels stand on anything solid, static geometry and heightfields included.
+// Ghosts and bodies without contact response are passed through.
+static inline bool
+isWheelGround(
+    const btCollisionObject *object)
+{
+  return object->hasContactResponse() && btGhostObject::upcast(object) == nullptr;
+}
+
+// btRaycastVehicle only checks the returned pointer for null and then uses
+// the fixed body as the ground, so the hit object is returned as is
+void *
+EvVehicleRaycaster::castRay(
+    const btVector3 &from,
+    const btVector3 &to,
+    btVehicleRaycasterResult &result)
+{
+  // btRaycastVehicle casts its wheels in order
+  if(cursor < hits.size()) {
+    const Hit &hit = hits[cursor++];
+    if(hit.from == from && hit.to == to) {
+      if(hit.object != nullptr) {
+        result = hit.result;
+      }
+      return const_cast<btCollisionObject*>(hit.object);
+    }
+  }
+
+  if(world == nullptr) {
+    return nullptr;
+  }
+
+  // Like btDefaultVehicleRaycaster, with the ground rules of the batch
+  btCollisionWorld::ClosestRayResultCallback rayResult(from, to);
+  world->rayTest(from, to, rayResult);
+  if(rayResult.hasHit()) {
+    const btCollisionObject *object = rayResult.m_collisionObject;
+    if(isWheelGround(object)) {
+      result.m_hitPointInWorld = rayResult.m_hitPointWorld;
+      result.m_hitNormalInWorld = rayResult.m_hitNormalWorld.normalized();
+      result.m_distFraction = rayResult.m_closestHitFraction;
+      return const_cast<btCollisionObject*>(object);
+    }
+  }
+  return nullptr;
+}
+
+// Ground objects the rays' default filter accepts. The chassis is left out,
+// rays starting inside it never hit it anyway.
+static inline bool
+isWheelCandidate(
+    const btRigidBody *chassis,
+    const btBroadphaseProxy *proxy)
+{
+  const btCollisionObject *object = static_cast<const btCollisionObject*>(proxy->m_clientObject);
+  return object != chassis
+    && isWheelGround(object)
+    && (proxy->m_collisionFilterGroup & btBroadphaseProxy::AllFilter)
+    && (btBroadphaseProxy::DefaultFilter & proxy->m_collisionFilterMask);
+}
+
+// Broadphase leaf against vehicle leaf
+struct CandidatePairCollector : public btDbvt::ICollide
+{
+  void Process(const btDbvtNode *objectLeaf, const btDbvtNode *vehicleLeaf)
+  {
+    const btDbvtProxy *proxy = static_cast<const btDbvtProxy*>(objectLeaf->data);
+    EvVehicleRaycaster *raycaster = static_cast<EvVehicleRaycaster*>(vehicleLeaf->data);
+    if(isWheelCandidate(raycaster->vehicle->getRigidBody(), proxy)) {
+      raycaster->candidates.push_back(static_cast<const btCollisionObject*>(proxy->m_clientObject));
+    }
+  }
+};
+
+// One object's AABB against the vehicle tree
+struct CandidateCollector : public btDbvt::ICollide
+{
+  const btBroadphaseProxy *proxy;
+
+  void Process(const btDbvtNode *vehicleLeaf)
+  {
+    EvVehicleRaycaster *raycaster = static_cast<EvVehicleRaycaster*>(vehicleLeaf->data);
+    if(isWheelCandidate(raycaster->vehicle->getRigidBody(), proxy)) {
+      raycaster->candidates.push_back(static_cast<const btCollisionObject*>(proxy->m_clientObject));
+    }
+  }
+};
+
+struct VehicleRayPass : public btIParallelForBody
+{
+  enum Pass {
+    // Computes the wheel rays and their bounds
+    PREPARE_RAYS,
+    // Tests the rays against the vehicle's candidates
+    CAST_RAYS,
+  };
+
+  EvVehicleRaycaster * const *raycasters;
+  Pass pass;
+
+  void prepare(EvVehicleRaycaster &raycaster) const
+  {
+    btRaycastVehicle *vehicle = raycaster.vehicle;
+    raycaster.hits.resize(vehicle->getNumWheels());
+    raycaster.cursor = 0;
+    raycaster.candidates.resize(0);
+
+    btVector3 boundsMin(BT_LARGE_FLOAT, BT_LARGE_FLOAT, BT_LARGE_FLOAT);
+    btVector3 boundsMax(-BT_LARGE_FLOAT, -BT_LARGE_FLOAT, -BT_LARGE_FLOAT);
+    for(int i = 0; i < vehicle->getNumWheels(); ++i) {
+      // Mirrors btRaycastVehicle::rayCast, so the cached rays match exactly
+      btWheelInfo &wheel = vehicle->getWheelInfo(i);
+      vehicle->updateWheelTransformsWS(wheel, false);
+      btScalar rayLength = wheel.getSuspensionRestLength() + wheel.m_wheelsRadius;
+      btVector3 rayVector = wheel.m_raycastInfo.m_wheelDirectionWS * rayLength;
+
+      EvVehicleRaycaster::Hit &hit = raycaster.hits[i];
+      hit.from = wheel.m_raycastInfo.m_hardPointWS;
+      hit.to = hit.from + rayVector;
+      hit.object = nullptr;
+
+      boundsMin.setMin(hit.from);
+      boundsMin.setMin(hit.to);
+      boundsMax.setMax(hit.from);
+      boundsMax.setMax(hit.to);
+    }
+    raycaster.bounds = btDbvtVolume::FromMM(boundsMin, boundsMax);
+  }
+
+  void cast(EvVehicleRaycaster &raycaster) const
+  {
+    for(int i = 0; i < raycaster.hits.size(); ++i) {
+      EvVehicleRaycaster::Hit &hit = raycaster.hits[i];
+      btCollisionWorld::ClosestRayResultCallback rayResult(hit.from, hit.to);
+      btTransform fromTransform(btQuaternion::getIdentity(), hit.from);
+      btTransform toTransform(btQuaternion::getIdentity(), hit.to);
+
+      for(int c = 0; c < raycaster.candidates.size(); ++c) {
+        const btCollisionObject *object = raycaster.candidates[c];
+        const btBroadphaseProxy *proxy = object->getBroadphaseHandle();
+        btScalar enter = 1.f;
+        btVector3 normal;
+        if(!btRayAabb(hit.from, hit.to, proxy->m_aabbMin, proxy->m_aabbMax, enter, normal)
+            || enter > rayResult.m_closestHitFraction) {
+          continue;
+        }
+        btCollisionWorld::rayTestSingle(fromTransform, toTransform,
+            const_cast<btCollisionObject*>(object), object->getCollisionShape(), object->getWorldTransform(),
+            rayResult);
+      }
+
+      if(rayResult.hasHit()) {
+        hit.object = rayResult.m_collisionObject;
+        hit.result.m_hitPointInWorld = rayResult.m_hitPointWorld;
+        hit.result.m_hitNormalInWorld = rayResult.m_hitNormalWorld.normalized();
+        hit.result.m_distFraction = rayResult.m_closestHitFraction;
+      }
+    }
+  }
+
+  void forLoop(int iBegin, int iEnd) const override
+  {
+    for(int i = iBegin; i < iEnd; ++i) {
+      switch(pass) {
+        case PREPARE_RAYS: prepare(*raycasters[i]); break;
+        case CAST_RAYS: cast(*raycasters[i]); break;
+      }
+    }
+  }
+};
+
+EvVehicleBatch::EvVehicleBatch()
+{}
+
+EvVehicleBatch::~EvVehicleBatch()
+{
+  for(int i = 0; i < vehicles.size(); ++i) {
+    delete vehicles[i]->vehicle;
+    delete vehicles[i];
+  }
+}
+
+btRaycastVehicle *
+EvVehicleBatch::addVehicle(
+    const btRaycastVehicle::btVehicleTuning &tuning,
+    btRigidBody *chassis)
+{
+  EvVehicleRaycaster *raycaster = new EvVehicleRaycaster();
+  raycaster->vehicle = new btRaycastVehicle(tuning, chassis, raycaster);
+  vehicles.push_back(raycaster);
+  return raycaster->vehicle;
+}
+
+void
+EvVehicleBatch::removeVehicle(
+    btRaycastVehicle *vehicle)
+{
+  for(int i = 0; i < vehicles.size(); ++i) {
+    if(vehicles[i]->vehicle == vehicle) {
+      delete vehicle;
+      delete vehicles[i];
+      vehicles.swap(i, vehicles.size() - 1);
+      vehicles.pop_back();
+      return;
+    }
+  }
+}
+
+void
+EvVehicleBatch::gatherCandidates(
+    btCollisionWorld *world)
+{
+  queries.clear();
+  for(int i = 0; i < active.size(); ++i) {
+    queries.insert(active[i]->bounds, active[i]);
+  }
+
+  btDbvtBroadphase *dbvt = dynamic_cast<btDbvtBroadphase*>(world->getBroadphase());
+  if(dbvt != nullptr) {
+    // Both broadphase trees against the vehicles in one traversal each
+    CandidatePairCollector collector;
+    for(int s = 0; s < 2; ++s) {
+      if(dbvt->m_sets[s].m_root != nullptr) {
+        queries.collideTT(dbvt->m_sets[s].m_root, queries.m_root, collector);
+      }
+    }
+    return;
+  }
+
+  // Other broadphases have no tree to walk, every object goes through the
+  // vehicle tree once
+  CandidateCollector collector;
+  const btCollisionObjectArray &objects = world->getCollisionObjectArray();
+  for(int i = 0; i < objects.size(); ++i) {
+    collector.proxy = objects[i]->getBroadphaseHandle();
+    if(collector.proxy == nullptr) {
+      continue;
+    }
+    queries.collideTV(queries.m_root, btDbvtVolume::FromMM(collector.proxy->m_aabbMin, collector.proxy->m_aabbMax), collector);
+  }
+}
+
+void
+EvVehicleBatch::updateAction(
+    btCollisionWorld *world,
+    btScalar timeStep)
+{
+  // Sleeping vehicles and those parked out of the world are left alone
+  active.resize(0);
+  for(int i = 0; i < vehicles.size(); ++i) {
+    btRigidBody *chassis = vehicles[i]->vehicle->getRigidBody();
+    if(chassis->getBroadphaseHandle() == nullptr || !chassis->isActive()) {
+      continue;
+    }
+    vehicles[i]->world = world;
+    active.push_back(vehicles[i]);
+  }
+  if(active.size() == 0) {
+    return;
+  }
+
+  VehicleRayPass pass;
+  pass.raycasters = &active[0];
+  pass.pass = VehicleRayPass::PREPARE_RAYS;
+  btParallelFor(0, active.size(), 16, pass);
+
+  gatherCandidates(world);
+
+  pass.pass = VehicleRayPass::CAST_RAYS;
+  btParallelFor(0, active.size(), 4, pass);
+
+  // Vehicles push on the bodies they stand on, so they are updated in order
+  for(int i = 0; i < active.size(); ++i) {
+    active[i]->vehicle->updateVehicle(timeStep);
+  }
+}
+
+void
+EvVehicleBatch::debugDraw(
+    btIDebugDraw *debugDrawer)
+{
+  for(int i = 0; i < vehicles.size(); ++i) {
+    vehicles[i]->vehicle->debugDraw(debugDrawer);
+  }
+}
@@ -3,6 +3,35 @@
 
 #define INVALID_WORLD_HANDLE (~0ull)
 
+#define DEFAULT_MAX_SUBSTEPS 10
+#define DEFAULT_FIXED_TIMESTEP (1.f / 60.f)
+
+#define DEFAULT_WORLD_EXTENT 1000.f
+#define DEFAULT_MAX_PROXIES 16384
+// btAxisSweep3 asserts maxHandles < 32767
+#define AXIS_SWEEP_16BIT_MAX_PROXIES 32766
+#define DEFAULT_GRID_CELL_SIZE 4.f
+// Bullet's solver defaults
+#define DEFAULT_GRAVITY -10.f
+#define DEFAULT_SOLVER_ITERATIONS 10
+#define DEFAULT_SPLIT_IMPULSE_THRESHOLD -.04f
+#define DEFAULT_WARMSTARTING_FACTOR .85f
+// Bullet's own pool defaults
+#define DEFAULT_MANIFOLD_POOL_SIZE 4096
+#define DEFAULT_ALGORITHM_POOL_SIZE 4096
+
+// Progress calls between two streaming passes
+#define STREAMING_UPDATE_INTERVAL 8
+// Objects leave the world a bit further out than they come back, so bodies
+// on the edge of the radius don't flip every pass
+#define STREAMING_EXIT_FACTOR 1.1f
+
+#define DEFAULT_HULL_VERTEX_BUDGET 32
+#define DEFAULT_DECOMPOSITION_HULL_COUNT 16
+#define DEFAULT_SHAPE_CACHE_DIR "cache/physics"
+#define DEFAULT_MAX_MESH_BUILDS 2
+#define DEFAULT_CAPTURE_PATH "physics.evcap"
+
 #define TYPE_MODULE evmod_physics
 #include <evol/meta/type_import.h>
 
@@ -11,6 +40,12 @@
 
 #include <btBulletDynamicsCommon.h>
 #include <btBulletCollisionCommon.h>
+#include <BulletCollision/CollisionDispatch/btGhostObject.h>
+#include <BulletDynamics/Character/btKinematicCharacterController.h>
+#include <BulletDynamics/ConstraintSolver/btNNCGConstraintSolver.h>
+#include <BulletDynamics/MLCPSolvers/btMLCPSolver.h>
+#include <BulletDynamics/MLCPSolvers/btDantzigSolver.h>
+#include <LinearMath/btQuickprof.h>
 
 #include "visual-dbg/BulletDbg.hpp"
 
@@ -18,10 +53,28 @@
 #include <mutex>
 
 #include <EvMotionState.h>
+#include <EvDynamicsWorld.h>
+#include <EvCollisionDispatcher.h>
+#include <EvArena.h>
+#include <EvStateHasher.h>
+#include <EvMeshBuilder.h>
+#include <EvCapture.h>
+#include <EvGameStub.h>
+#include <EvReplay.h>
+#include <EvObjectPool.h>
+#include <EvConvexDecomposition.h>
+#include <EvHeightfieldShape.h>
+#include <EvGridBroadphase.h>
+#include <EvSoftWorld.h>
+#include <EvVehicleBatch.h>
 
 #include <physics_api.h>
 
 #include <vector>
+#include <string>
+#include <algorithm>
+#include <cinttypes>
+#include <cstring>
 
 #define ev2btVec3(v) btVector3(v.x, v.y, v.z)
 #define bt2evVec3(v) {{  v.x(), v.y(), v.z() }}
@@ -29,17 +82,106 @@
 struct RigidbodyData {
   GenericHandle entt_id;
   GenericHandle game_scene;
+  // Resolved once at creation, the scene's world doesn't change
+  PhysicsWorldHandle world_handle;
+  // Position in the dormant store, -1 while the object is in the world
+  I32 dormantIndex = -1;
+  // Position in a deterministic world's pending adds, -1 once added
+  I32 pendingIndex = -1;
+  // Position in the objects waiting for their mesh to build, -1 otherwise
+  I32 waitingIndex = -1;
+};
+
+// Bodies far from every anchor are taken out of the dynamics world and parked
+// here. Their transform, velocity and shape stay on the detached object, so
+// RigidbodyHandles held by components remain valid while dormant. Leaving the
+// world frees their broadphase proxy, pairs and manifolds; the objects
+// themselves are kept because handles point at them.
+// The same anchors drive simulation LOD: bodies past the LOD distances move
+// to the world's reduced or ballistic tiers.
+struct StreamingState {
+  btAlignedObjectArray<btVector3> anchors;
+  btAlignedObjectArray<bool> anchorUsed;
+  F32 radius;
+  U32 framesUntilUpdate;
+
+  btAlignedObjectArray<btCollisionObject*> dormantObjects;
+
+  F32 lodReducedDistance;
+  F32 lodBallisticDistance;
+  U32 lodFramesUntilUpdate;
+};
+
+// Filled from the dispatcher's manifolds after every progress call. Holds one
+// entry per touching pair, located at its strongest contact point.
+struct ContactReport {
+  btAlignedObjectArray<ContactPoint> contacts;
+  U32 capacity;
+  F32 minImpulse;
+  U32 droppedCount;
+};
+
+struct CharacterController {
+  btPairCachingGhostObject *ghost;
+  btKinematicCharacterController *controller;
+  EvMotionState *motionState;
+};
+
+struct VehicleController {
+  btRaycastVehicle *vehicle;
+  btAlignedObjectArray<bool> drivenWheels;
+  // One per wheel, null for wheels without a game object
+  btAlignedObjectArray<EvMotionState*> wheelStates;
+  // As of the last progress call, interpolated like the chassis
+  btAlignedObjectArray<btTransform> wheelTransforms;
 };
 
 struct PhysicsWorld {
   btCollisionConfiguration *collisionConfiguration;
-  btCollisionDispatcher *collisionDispatcher;
+  EvCollisionDispatcher *collisionDispatcher;
   btBroadphaseInterface *broadphase;
-  btSequentialImpulseConstraintSolver *constraintSolver;
-  btDynamicsWorld *world;
+  // A solver pool under BT_THREADSAFE
+  btConstraintSolver *constraintSolver;
+  // One per pooled solver when the block solver is used
+  btAlignedObjectArray<btMLCPSolverInterface*> mlcpSolvers;
+  EvDynamicsWorld *world;
 
   btAlignedObjectArray<btCollisionShape*> collisionShapes;
 
+  EvObjectPool<RigidbodyData> *rbDataPool;
+  EvObjectPool<EvMotionState> *motionStatePool;
+
+  btAlignedObjectArray<CharacterController*> characters;
+  btGhostPairCallback *ghostPairCallback;
+
+  btAlignedObjectArray<VehicleController*> vehicles;
+  // Created with the first vehicle
+  EvVehicleBatch *vehicleBatch;
+
+  StreamingState *streaming;
+  ContactReport *contactReport;
+  EvStateHasher *stateHasher;
+  // Created with the first soft body
+  EvSoftWorld *softWorld;
+
+  // Null unless the world was created with an arena size
+  EvArena *arena;
+
+  PhysicsWorldInfo info;
+  PhysicsWorldStats stats;
+
+  U32 maxSubSteps;
+  F32 fixedTimeStep;
+
+  // Deterministic worlds step exactly one fixed tick per progress call and
+  // add new objects at the start of the next tick, ordered by entity
+  bool deterministic;
+  U64 tick;
+  btAlignedObjectArray<btCollisionObject*> pendingObjects;
+
+  // Objects created against a mesh that is still being built
+  btAlignedObjectArray<btCollisionObject*> waitingObjects;
+
   std::mutex worldMtx;
   std::mutex shapeVecMtx;
 
@@ -49,9 +191,38 @@ struct PhysicsWorld {
     collisionDispatcher = old.collisionDispatcher;
     broadphase = old.broadphase;
     constraintSolver = old.constraintSolver;
+    mlcpSolvers = old.mlcpSolvers;
     world = old.world;
 
     collisionShapes = old.collisionShapes;
+
+    rbDataPool = old.rbDataPool;
+    motionStatePool = old.motionStatePool;
+
+    characters = old.characters;
+    ghostPairCallback = old.ghostPairCallback;
+
+    vehicles = old.vehicles;
+    vehicleBatch = old.vehicleBatch;
+
+    streaming = old.streaming;
+    contactReport = old.contactReport;
+    stateHasher = old.stateHasher;
+    softWorld = old.softWorld;
+
+    arena = old.arena;
+
+    info = old.info;
+    stats = old.stats;
+
+    maxSubSteps = old.maxSubSteps;
+    fixedTimeStep = old.fixedTimeStep;
+
+    deterministic = old.deterministic;
+    tick = old.tick;
+    pendingObjects = old.pendingObjects;
+
+    waitingObjects = old.waitingObjects;
   }
 
   PhysicsWorld() = default;
@@ -66,6 +237,13 @@ struct ev_PhysicsData {
   evolmodule_t game_mod;
   evolmodule_t asset_mod;
 
+  std::string shapeCacheDir;
+
+  EvMeshBuilder *meshBuilder;
+
+  // Installed by `_ev_physics_setworkerthreads`, owned by the module
+  btITaskScheduler *taskScheduler;
+
   bool visualizationEnabled;
 } PhysicsData;
 
@@ -76,275 +254,2638 @@ void
 contactEndedCallback(
     btPersistentManifold* const& manifold);
 
+void
+_ev_rigidbody_releasedata(
+    PhysicsWorld &physWorld,
+    btCollisionObject *object);
+
+void
+_ev_rigidbody_refreshmoved(
+    btCollisionObject *object);
+
+void
+_ev_physicsworld_updatestreaming(
+    PhysicsWorld &physWorld);
+
+void
+_ev_physicsworld_updatelod(
+    PhysicsWorld &physWorld);
+
+void
+_ev_physicsworld_gathercontacts(
+    PhysicsWorld &physWorld,
+    int stepCount);
+
+void
+_ev_physicsworld_reinsert(
+    PhysicsWorld &physWorld,
+    btCollisionObject *object);
+
+void
+_ev_physicsworld_forgetdetached(
+    PhysicsWorld &physWorld,
+    RigidbodyData *rbData);
+
+bool
+_ev_meshasset_loadtriangles(
+    const char *path,
+    btTriangleMesh *mesh);
+
+void
+_ev_physicsworld_addobject(
+    PhysicsWorld &physWorld,
+    btCollisionObject *object);
+
+void
+_ev_physicsworld_mirrorstatic(
+    PhysicsWorld &physWorld,
+    btCollisionObject *object);
+
+void
+_ev_physicsworld_syncvehicles(
+    PhysicsWorld &physWorld);
+
+void
+_ev_physicsworld_forgetchassis(
+    PhysicsWorld &physWorld,
+    btCollisionObject *object);
+
+void
+_ev_physicsworld_setdeterministic(
+    PhysicsWorld &physWorld,
+    bool deterministic);
+
+void
+_ev_physicsworld_flushpending(
+    PhysicsWorld &physWorld);
+
+PhysicsWorldHandle
+_ev_physics_sceneworld(
+    GameScene game_scene);
+
+PhysicsWorldInfo
+ev_physicsworld_getdefaultinfo()
+{
+  PhysicsWorldInfo info = {};
+  info.broadphase = EV_PHYSICS_BROADPHASE_DBVT;
+  // Bullet's defaults
+  info.dbvtDynamicUpdateRate = 0;
+  info.dbvtStaticUpdateRate = 1;
+  info.worldAabbMin = {{ -DEFAULT_WORLD_EXTENT, -DEFAULT_WORLD_EXTENT, -DEFAULT_WORLD_EXTENT }};
+  info.worldAabbMax = {{ DEFAULT_WORLD_EXTENT, DEFAULT_WORLD_EXTENT, DEFAULT_WORLD_EXTENT }};
+  info.maxProxies = DEFAULT_MAX_PROXIES;
+  info.gridCellSize = DEFAULT_GRID_CELL_SIZE;
+  info.manifoldPoolSize = DEFAULT_MANIFOLD_POOL_SIZE;
+  info.collisionAlgorithmPoolSize = DEFAULT_ALGORITHM_POOL_SIZE;
+  info.arenaSize = 0;
+  info.maxSubSteps = DEFAULT_MAX_SUBSTEPS;
+  info.fixedTimeStep = DEFAULT_FIXED_TIMESTEP;
+  info.deterministic = false;
+  info.solver = EV_PHYSICS_SOLVER_SEQUENTIAL_IMPULSE;
+  info.solverParams.gravity = {{ 0.f, DEFAULT_GRAVITY, 0.f }};
+  info.solverParams.iterations = DEFAULT_SOLVER_ITERATIONS;
+  info.solverParams.simd = true;
+  info.solverParams.splitImpulse = true;
+  info.solverParams.splitImpulsePenetrationThreshold = DEFAULT_SPLIT_IMPULSE_THRESHOLD;
+  info.solverParams.warmStarting = true;
+  info.solverParams.warmStartingFactor = DEFAULT_WARMSTARTING_FACTOR;
+
+  return info;
+}
+
+btBroadphaseInterface *
+_ev_physicsworld_newbroadphase(
+    const PhysicsWorldInfo &info)
+{
+  switch(info.broadphase) {
+    case EV_PHYSICS_BROADPHASE_AXIS_SWEEP:
+      // The 16 bit variant can't address 32767 handles or more
+      if(info.maxProxies > AXIS_SWEEP_16BIT_MAX_PROXIES) {
+        return new bt32BitAxisSweep3(ev2btVec3(info.worldAabbMin), ev2btVec3(info.worldAabbMax), info.maxProxies);
+      }
+      return new btAxisSweep3(ev2btVec3(info.worldAabbMin), ev2btVec3(info.worldAabbMax), info.maxProxies);
+
+    case EV_PHYSICS_BROADPHASE_UNIFORM_GRID:
+      return new EvGridBroadphase(info.gridCellSize);
+
+    case EV_PHYSICS_BROADPHASE_DBVT:
+    default:
+      {
+        btDbvtBroadphase *dbvt = new btDbvtBroadphase();
+        dbvt->m_dupdates = info.dbvtDynamicUpdateRate;
+        dbvt->m_fupdates = info.dbvtStaticUpdateRate;
+        return dbvt;
+      }
+  }
+}
+
+btConstraintSolver *
+_ev_physicsworld_newsinglesolver(
+    PhysicsWorld &physWorld,
+    PhysicsSolverType type)
+{
+  switch(type) {
+    case EV_PHYSICS_SOLVER_NNCG:
+      return new btNNCGConstraintSolver();
+
+    case EV_PHYSICS_SOLVER_BLOCK:
+      {
+        // Dantzig keeps scratch buffers, so every solver gets its own
+        btMLCPSolverInterface *mlcp = new btDantzigSolver();
+        physWorld.mlcpSolvers.push_back(mlcp);
+        return new btMLCPSolver(mlcp);
+      }
+
+    case EV_PHYSICS_SOLVER_SEQUENTIAL_IMPULSE:
+    default:
+      return new btSequentialImpulseConstraintSolver();
+  }
+}
+
+// Under BT_THREADSAFE, one solver for every thread a scheduler can have, so
+// islands can be solved concurrently whatever worker count is installed
+// later. Solvers only allocate their buffers once they are used.
+btConstraintSolver *
+_ev_physicsworld_newsolver(
+    PhysicsWorld &physWorld,
+    PhysicsSolverType type)
+{
+#if BT_THREADSAFE
+  btAlignedObjectArray<btConstraintSolver*> solvers;
+  for(int i = 0; i < BT_MAX_THREAD_COUNT; ++i) {
+    solvers.push_back(_ev_physicsworld_newsinglesolver(physWorld, type));
+  }
+  // The pool takes ownership of the solvers
+  return new btConstraintSolverPoolMt(&solvers[0], solvers.size());
+#else
+  return _ev_physicsworld_newsinglesolver(physWorld, type);
+#endif
+}
+
+void
+_ev_physicsworld_setsolverparams(
+    PhysicsWorld &physWorld,
+    const PhysicsSolverParams &params)
+{
+  btContactSolverInfo &solverInfo = physWorld.world->getSolverInfo();
+  solverInfo.m_numIterations = params.iterations > 0 ? params.iterations : DEFAULT_SOLVER_ITERATIONS;
+  solverInfo.m_splitImpulse = params.splitImpulse;
+  solverInfo.m_splitImpulsePenetrationThreshold = params.splitImpulsePenetrationThreshold;
+  solverInfo.m_warmstartingFactor = params.warmStartingFactor;
+
+  if(params.simd) {
+    solverInfo.m_solverMode |= SOLVER_SIMD;
+  } else {
+    solverInfo.m_solverMode &= ~SOLVER_SIMD;
+  }
+  if(params.warmStarting) {
+    solverInfo.m_solverMode |= SOLVER_USE_WARMSTARTING;
+  } else {
+    solverInfo.m_solverMode &= ~SOLVER_USE_WARMSTARTING;
+  }
+
+  btVector3 gravity = ev2btVec3(params.gravity);
+  physWorld.world->setGravity(gravity);
+  for(int i = 0; i < physWorld.characters.size(); ++i) {
+    physWorld.characters[i]->controller->setGravity(gravity);
+  }
+  if(physWorld.softWorld != nullptr) {
+    physWorld.softWorld->setGravity(gravity);
+  }
+
+  physWorld.info.solverParams = params;
+}
+
+void
+ev_physicsworld_setsolverparams(
+    PhysicsWorldHandle world_handle,
+    PhysicsSolverParams params)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_WORLD_SETSOLVERPARAMS, world_handle, params);
+
+  _ev_physicsworld_setsolverparams(physWorld, params);
+}
+
+PhysicsSolverParams
+ev_physicsworld_getsolverparams(
+    PhysicsWorldHandle world_handle)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+
+  return physWorld.info.solverParams;
+}
+
 PhysicsWorldHandle
 ev_physicsworld_newworld()
+{
+  return ev_physicsworld_newworldex(ev_physicsworld_getdefaultinfo());
+}
+
+PhysicsWorldHandle
+ev_physicsworld_newworldex(
+    PhysicsWorldInfo info)
 {
   PhysicsWorld newWorld;
-  newWorld.collisionConfiguration = new btDefaultCollisionConfiguration();
-  newWorld.collisionDispatcher = new btCollisionDispatcher(newWorld.collisionConfiguration);
-  newWorld.broadphase = new btDbvtBroadphase();
-  newWorld.constraintSolver = new btSequentialImpulseConstraintSolver();
-  newWorld.world = new btDiscreteDynamicsWorld(newWorld.collisionDispatcher, newWorld.broadphase, newWorld.constraintSolver, newWorld.collisionConfiguration);
+  newWorld.info = info;
+  newWorld.stats = {};
+
+  // Everything the world allocates from here on comes out of its arena. The
+  // hook only goes in once a world asks for one.
+  newWorld.arena = nullptr;
+  if(info.arenaSize > 0) {
+    EvArena::install();
+    newWorld.arena = new EvArena(info.arenaSize);
+  }
+  EvArena *previousArena = EvArena::setCurrent(newWorld.arena);
+
+  btDefaultCollisionConstructionInfo collisionInfo;
+  if(info.manifoldPoolSize > 0) {
+    collisionInfo.m_defaultMaxPersistentManifoldPoolSize = info.manifoldPoolSize;
+  }
+  if(info.collisionAlgorithmPoolSize > 0) {
+    collisionInfo.m_defaultMaxCollisionAlgorithmPoolSize = info.collisionAlgorithmPoolSize;
+  }
+  newWorld.collisionConfiguration = new btDefaultCollisionConfiguration(collisionInfo);
+  newWorld.collisionDispatcher = new EvCollisionDispatcher(newWorld.collisionConfiguration);
+  newWorld.broadphase = _ev_physicsworld_newbroadphase(info);
+  newWorld.constraintSolver = _ev_physicsworld_newsolver(newWorld, info.solver);
+  newWorld.world = new EvDynamicsWorld(newWorld.collisionDispatcher, newWorld.broadphase, newWorld.constraintSolver, newWorld.collisionConfiguration);
+  // Only active objects get their AABBs recomputed each step
+  newWorld.world->setForceUpdateAllAabbs(false);
+
+  newWorld.rbDataPool = new EvObjectPool<RigidbodyData>();
+  newWorld.motionStatePool = new EvObjectPool<EvMotionState>();
+
+  // Created with the first character
+  newWorld.ghostPairCallback = nullptr;
+  // Created with the first vehicle
+  newWorld.vehicleBatch = nullptr;
+
+  newWorld.streaming = new StreamingState();
+  newWorld.streaming->radius = 0.f;
+  newWorld.streaming->framesUntilUpdate = 0;
+  newWorld.streaming->lodReducedDistance = 0.f;
+  newWorld.streaming->lodBallisticDistance = 0.f;
+  newWorld.streaming->lodFramesUntilUpdate = 0;
+
+  // Disabled until a capacity is set
+  newWorld.contactReport = new ContactReport();
+  newWorld.contactReport->capacity = 0;
+  newWorld.contactReport->minImpulse = 0.f;
+  newWorld.contactReport->droppedCount = 0;
+
+  newWorld.stateHasher = new EvStateHasher();
+  newWorld.softWorld = nullptr;
+
+  newWorld.maxSubSteps = info.maxSubSteps;
+  newWorld.fixedTimeStep = info.fixedTimeStep > 0.f ? info.fixedTimeStep : DEFAULT_FIXED_TIMESTEP;
+
+  _ev_physicsworld_setsolverparams(newWorld, info.solverParams);
+
+  newWorld.tick = 0;
+  newWorld.deterministic = false;
+  _ev_physicsworld_setdeterministic(newWorld, info.deterministic);
 
   if(PhysicsData.visualizationEnabled) {
     newWorld.world->setDebugDrawer(PhysicsData.debugDrawer);
   }
 
+  EvArena::setCurrent(previousArena);
+
   PhysicsData.worlds.push_back(newWorld);
+  PhysicsWorldHandle world_handle = (PhysicsWorldHandle) (PhysicsData.worlds.size() - 1);
+
+  {
+    std::lock_guard<std::mutex> guard(PhysicsData.worlds[world_handle].worldMtx);
+    EV_CAPTURE(EV_CAPTURE_WORLD_NEW, info, world_handle);
+  }
 
-  return (PhysicsWorldHandle) (PhysicsData.worlds.size() - 1);
+  return world_handle;
 }
 
-PhysicsWorldHandle
-ev_physicsworld_invalidhandle()
+void
+ev_physicsworld_freezestatics(
+    PhysicsWorldHandle world_handle)
 {
-  return INVALID_WORLD_HANDLE;
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_WORLD_FREEZESTATICS, world_handle);
+
+  physWorld.world->freezeStaticObjects();
+}
+
+U32
+ev_physicsworld_addanchor(
+    PhysicsWorldHandle world_handle,
+    Vec3 position)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_WORLD_ADDANCHOR, world_handle, position);
+  StreamingState *streaming = physWorld.streaming;
+
+  U32 anchor = streaming->anchorUsed.findLinearSearch(false);
+  if(anchor == (U32)streaming->anchorUsed.size()) {
+    streaming->anchors.push_back(ev2btVec3(position));
+    streaming->anchorUsed.push_back(true);
+  } else {
+    streaming->anchors[anchor] = ev2btVec3(position);
+    streaming->anchorUsed[anchor] = true;
+  }
+
+  return anchor;
+}
+
+// Anchor ids come from scripts
+bool
+_ev_physicsworld_isanchor(
+    const StreamingState *streaming,
+    U32 anchor)
+{
+  return anchor < (U32)streaming->anchorUsed.size() && streaming->anchorUsed[anchor];
 }
 
 void
-ev_physicsworld_destroyworld(
-    PhysicsWorldHandle world_handle)
+ev_physicsworld_setanchorposition(
+    PhysicsWorldHandle world_handle,
+    U32 anchor,
+    Vec3 position)
 {
-  if(world_handle == INVALID_WORLD_HANDLE) {
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_WORLD_SETANCHORPOSITION, world_handle, anchor, position);
+
+  if(!_ev_physicsworld_isanchor(physWorld.streaming, anchor)) {
+    ev_log_warn("Tried to move unknown streaming anchor %u", anchor);
     return;
   }
+  physWorld.streaming->anchors[anchor] = ev2btVec3(position);
+}
+
+// Puts every dormant object back in the world, for when nothing drives the
+// streaming anymore
+void
+_ev_physicsworld_reinsertdormant(
+    PhysicsWorld &physWorld)
+{
+  btAlignedObjectArray<btCollisionObject*> &dormant = physWorld.streaming->dormantObjects;
+  for(int i = 0; i < dormant.size(); ++i) {
+    reinterpret_cast<RigidbodyData*>(dormant[i]->getUserPointer())->dormantIndex = -1;
+    _ev_physicsworld_reinsert(physWorld, dormant[i]);
+  }
+  dormant.clear();
+}
+
+void
+ev_physicsworld_removeanchor(
+    PhysicsWorldHandle world_handle,
+    U32 anchor)
+{
   PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
-  if(physWorld.world == nullptr) {
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_WORLD_REMOVEANCHOR, world_handle, anchor);
+
+  if(!_ev_physicsworld_isanchor(physWorld.streaming, anchor)) {
+    ev_log_warn("Tried to remove unknown streaming anchor %u", anchor);
     return;
   }
+  physWorld.streaming->anchorUsed[anchor] = false;
+
+  // Streaming stops with the last anchor, nothing would bring these back
+  btAlignedObjectArray<bool> &anchorUsed = physWorld.streaming->anchorUsed;
+  if(anchorUsed.findLinearSearch(true) == anchorUsed.size()) {
+    _ev_physicsworld_reinsertdormant(physWorld);
+  }
+}
 
+void
+ev_physicsworld_setstreamingradius(
+    PhysicsWorldHandle world_handle,
+    F32 radius)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
   std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_WORLD_SETSTREAMINGRADIUS, world_handle, radius);
 
-  // Clear collision objects
-  auto collisionObjects = physWorld.world->getCollisionObjectArray();
-  for(int i = collisionObjects.size()-1; i >=0; --i) {
-    auto object = collisionObjects[i];
-    auto rb = btRigidBody::upcast(object);
+  physWorld.streaming->radius = radius;
+  physWorld.streaming->framesUntilUpdate = 0;
+
+  // Streaming turned off, everything goes back in
+  if(radius <= 0.f) {
+    _ev_physicsworld_reinsertdormant(physWorld);
+  }
+}
 
-    if(rb != nullptr) {
-      delete rb->getMotionState();
-      delete reinterpret_cast<RigidbodyData*>(rb->getUserPointer());
-      rb->setUserPointer(nullptr);
+btScalar
+_ev_physicsworld_anchordistance2(
+    const StreamingState *streaming,
+    const btVector3 &position)
+{
+  btScalar nearest = BT_LARGE_FLOAT;
+  for(int i = 0; i < streaming->anchors.size(); ++i) {
+    if(streaming->anchorUsed[i]) {
+      nearest = btMin(nearest, streaming->anchors[i].distance2(position));
     }
+  }
+  return nearest;
+}
 
+// Characters and constrained bodies always stay in the world
+bool
+_ev_physicsworld_isstreamable(
+    btCollisionObject *object)
+{
+  if(object->getUserPointer() == nullptr || (object->getCollisionFlags() & btCollisionObject::CF_CHARACTER_OBJECT)) {
+    return false;
+  }
+  btRigidBody *body = btRigidBody::upcast(object);
+  return body == nullptr || body->getNumConstraintRefs() == 0;
+}
 
-    physWorld.world->removeCollisionObject(object);
-    delete object;
+void
+_ev_physicsworld_reinsert(
+    PhysicsWorld &physWorld,
+    btCollisionObject *object)
+{
+  btRigidBody *body = btRigidBody::upcast(object);
+  if(body != nullptr) {
+    physWorld.world->addRigidBody(body);
+  } else {
+    physWorld.world->addCollisionObject(object,
+        btBroadphaseProxy::StaticFilter,
+        btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter);
+    // Back where freezeStatics put it before it went dormant
+    physWorld.world->freezeStaticObject(object);
   }
+}
 
-  // Clear collision shapes  
-  std::lock_guard<std::mutex> shapeGuard(physWorld.shapeVecMtx);
+void
+_ev_physicsworld_updatestreaming(
+    PhysicsWorld &physWorld)
+{
+  StreamingState *streaming = physWorld.streaming;
+  if(streaming->radius <= 0.f || streaming->anchorUsed.findLinearSearch(true) == streaming->anchorUsed.size()) {
+    return;
+  }
+  if(streaming->framesUntilUpdate > 0) {
+    streaming->framesUntilUpdate--;
+    return;
+  }
+  streaming->framesUntilUpdate = STREAMING_UPDATE_INTERVAL;
+
+  btScalar enterRadius2 = streaming->radius * streaming->radius;
+  btScalar exitRadius2 = enterRadius2 * STREAMING_EXIT_FACTOR * STREAMING_EXIT_FACTOR;
+
+  // Dormant objects that came back in range, re-inserted as one batch
+  btAlignedObjectArray<btCollisionObject*> &dormant = streaming->dormantObjects;
+  std::vector<btCollisionObject*> entering;
+  for(int i = dormant.size() - 1; i >= 0; --i) {
+    btCollisionObject *object = dormant[i];
+    if(_ev_physicsworld_anchordistance2(streaming, object->getWorldTransform().getOrigin()) <= enterRadius2) {
+      _ev_physicsworld_forgetdetached(physWorld, reinterpret_cast<RigidbodyData*>(object->getUserPointer()));
+      entering.push_back(object);
+    }
+  }
 
-  for(int i = 0; i < physWorld.collisionShapes.size(); ++i) {
-    delete physWorld.collisionShapes[i];
-    physWorld.collisionShapes[i] = nullptr;
+  // Objects out of range leave the world in one bulk removal
+  std::vector<btCollisionObject*> leaving;
+  const btCollisionObjectArray &objects = physWorld.world->getCollisionObjectArray();
+  for(int i = 0; i < objects.size(); ++i) {
+    btCollisionObject *object = objects[i];
+    if(_ev_physicsworld_isstreamable(object) &&
+       _ev_physicsworld_anchordistance2(streaming, object->getWorldTransform().getOrigin()) > exitRadius2) {
+      leaving.push_back(object);
+    }
   }
 
-  delete physWorld.world;
-  delete physWorld.constraintSolver;
-  delete physWorld.broadphase;
-  delete physWorld.collisionDispatcher;
-  delete physWorld.collisionConfiguration;
-  physWorld.world = nullptr;
-  physWorld.constraintSolver = nullptr;
-  physWorld.broadphase = nullptr;
-  physWorld.collisionDispatcher = nullptr;
-  physWorld.collisionConfiguration = nullptr;
+  if(!leaving.empty()) {
+    physWorld.world->removeCollisionObjects(leaving.data(), leaving.size());
+    for(btCollisionObject *object : leaving) {
+      reinterpret_cast<RigidbodyData*>(object->getUserPointer())->dormantIndex = dormant.size();
+      dormant.push_back(object);
+    }
+  }
+
+  for(btCollisionObject *object : entering) {
+    _ev_physicsworld_reinsert(physWorld, object);
+  }
+}
+
+void
+ev_physicsworld_setloddistances(
+    PhysicsWorldHandle world_handle,
+    F32 reducedDistance,
+    F32 ballisticDistance,
+    U32 reducedInterval)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_WORLD_SETLODDISTANCES, world_handle, reducedDistance, ballisticDistance, reducedInterval);
+
+  physWorld.streaming->lodReducedDistance = reducedDistance;
+  physWorld.streaming->lodBallisticDistance = ballisticDistance;
+  physWorld.streaming->lodFramesUntilUpdate = 0;
+  physWorld.world->setLodInterval(reducedInterval);
+}
+
+// Constrained bodies are solved together with their partners, so they keep
+// the full rate like characters and kinematic bodies
+bool
+_ev_physicsworld_haslod(
+    btCollisionObject *object)
+{
+  btRigidBody *body = btRigidBody::upcast(object);
+  return body != nullptr &&
+         !body->isStaticOrKinematicObject() &&
+         body->getUserPointer() != nullptr &&
+         body->getNumConstraintRefs() == 0;
+}
+
+void
+_ev_physicsworld_updatelod(
+    PhysicsWorld &physWorld)
+{
+  StreamingState *streaming = physWorld.streaming;
+  bool enabled = (streaming->lodReducedDistance > 0.f || streaming->lodBallisticDistance > 0.f) &&
+                 streaming->anchorUsed.findLinearSearch(true) != streaming->anchorUsed.size();
+  if(!enabled && physWorld.world->getNumLodBodies() == 0) {
+    return;
+  }
+  if(streaming->lodFramesUntilUpdate > 0) {
+    streaming->lodFramesUntilUpdate--;
+    return;
+  }
+  streaming->lodFramesUntilUpdate = STREAMING_UPDATE_INTERVAL;
+
+  btScalar reduced2 = streaming->lodReducedDistance * streaming->lodReducedDistance;
+  btScalar ballistic2 = streaming->lodBallisticDistance * streaming->lodBallisticDistance;
+
+  const btCollisionObjectArray &objects = physWorld.world->getCollisionObjectArray();
+  for(int i = 0; i < objects.size(); ++i) {
+    if(!_ev_physicsworld_haslod(objects[i])) {
+      continue;
+    }
+    btRigidBody *body = btRigidBody::upcast(objects[i]);
+
+    EvDynamicsWorld::LodTier tier = EvDynamicsWorld::LOD_FULL;
+    if(enabled) {
+      btScalar distance2 = _ev_physicsworld_anchordistance2(streaming, body->getWorldTransform().getOrigin());
+      if(streaming->lodBallisticDistance > 0.f && distance2 > ballistic2) {
+        tier = EvDynamicsWorld::LOD_BALLISTIC;
+      } else if(streaming->lodReducedDistance > 0.f && distance2 > reduced2) {
+        tier = EvDynamicsWorld::LOD_REDUCED;
+      }
+    }
+    physWorld.world->setBodyLod(body, tier);
+  }
+}
+
+void
+ev_physicsworld_setcontactreport(
+    PhysicsWorldHandle world_handle,
+    U32 capacity,
+    F32 minImpulse)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_WORLD_SETCONTACTREPORT, world_handle, capacity, minImpulse);
+  ContactReport *report = physWorld.contactReport;
+
+  report->capacity = capacity;
+  report->minImpulse = minImpulse;
+  report->contacts.clear();
+  report->contacts.reserve(capacity);
 }
 
+// Copied under the lock, a concurrent progress call rewrites the report
 U32
-ev_physicsworld_progress(
+ev_physicsworld_getcontacts(
     PhysicsWorldHandle world_handle,
-    F32 deltaTime)
+    ContactPoint *out_contacts,
+    U32 maxContacts)
 {
   PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
-  /* ev_log_trace("Progressing PhysicsWorld { %llu } with delta time { %f }", world_handle, deltaTime); */
   std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  ContactReport *report = physWorld.contactReport;
 
-  physWorld.world->stepSimulation(deltaTime, 10);
+  U32 count = report->contacts.size();
+  U32 copied = btMin(count, maxContacts);
+  if(copied > 0) {
+    memcpy(out_contacts, &report->contacts[0], copied * sizeof(ContactPoint));
+  }
+  return count;
+}
 
-  if(PhysicsData.visualizationEnabled && PhysicsData.debugDrawer && !PhysicsData.debugDrawer->windowDestroyed) {
-    /* ev_log_trace("Visualization enabled. Drawing frame from PhysicsWorld { %llu }", world_handle); */
-    PhysicsData.debugDrawer->startFrame();
-    physWorld.world->debugDrawWorld();
-    PhysicsData.debugDrawer->endFrame();
+// Manifolds keep the impulses of the last substep, a progress call that
+// didn't step would report the same impacts again
+void
+_ev_physicsworld_gathercontacts(
+    PhysicsWorld &physWorld,
+    int stepCount)
+{
+  ContactReport *report = physWorld.contactReport;
+  report->contacts.resizeNoInitialize(0);
+  report->droppedCount = 0;
+  if(report->capacity == 0 || stepCount == 0) {
+    return;
+  }
+
+  btDispatcher *dispatcher = physWorld.collisionDispatcher;
+  for(int i = 0; i < dispatcher->getNumManifolds(); ++i) {
+    btPersistentManifold *manifold = dispatcher->getManifoldByIndexInternal(i);
+    if(manifold->getNumContacts() == 0) {
+      continue;
+    }
+
+    const btCollisionObject *object0 = manifold->getBody0();
+    const btCollisionObject *object1 = manifold->getBody1();
+    RigidbodyData *rbData0 = reinterpret_cast<RigidbodyData*>(object0->getUserPointer());
+    RigidbodyData *rbData1 = reinterpret_cast<RigidbodyData*>(object1->getUserPointer());
+    if(rbData0 == nullptr || rbData1 == nullptr) {
+      continue;
+    }
+
+    btScalar totalImpulse = 0.f;
+    int strongest = 0;
+    for(int c = 0; c < manifold->getNumContacts(); ++c) {
+      btScalar impulse = manifold->getContactPoint(c).getAppliedImpulse();
+      totalImpulse += impulse;
+      if(impulse > manifold->getContactPoint(strongest).getAppliedImpulse()) {
+        strongest = c;
+      }
+    }
+    if(totalImpulse < report->minImpulse) {
+      continue;
+    }
+    if((U32)report->contacts.size() == report->capacity) {
+      report->droppedCount++;
+      continue;
+    }
+
+    const btManifoldPoint &point = manifold->getContactPoint(strongest);
+
+    // Speed the impulse took out of the approach along the normal. Rotation is
+    // ignored, which is close enough for sounds and damage.
+    btRigidBody *body0 = const_cast<btRigidBody*>(btRigidBody::upcast(object0));
+    btRigidBody *body1 = const_cast<btRigidBody*>(btRigidBody::upcast(object1));
+    btScalar inverseMass = (body0 ? body0->getInvMass() : 0.f) + (body1 ? body1->getInvMass() : 0.f);
+
+    ContactPoint &contact = report->contacts.expandNonInitializing();
+    contact.entityA = rbData0->entt_id;
+    contact.entityB = rbData1->entt_id;
+    contact.position = bt2evVec3(point.getPositionWorldOnB());
+    contact.normal = bt2evVec3(point.m_normalWorldOnB);
+    contact.impulse = totalImpulse;
+    contact.relativeSpeed = totalImpulse * inverseMass / (1.f + point.m_combinedRestitution);
+  }
+}
+
+// Rigidbodies use Bullet's default filters, everything else keeps its own
+void
+_ev_physicsworld_addobjectfiltered(
+    PhysicsWorld &physWorld,
+    btCollisionObject *object,
+    int group,
+    int mask)
+{
+  btRigidBody *body = btRigidBody::upcast(object);
+  if(body != nullptr) {
+    physWorld.world->addRigidBody(body);
+  } else {
+    physWorld.world->addCollisionObject(object, group, mask);
+  }
+}
+
+void
+_ev_physicsworld_addobject(
+    PhysicsWorld &physWorld,
+    btCollisionObject *object)
+{
+  EvPendingMeshShape *pendingShape = dynamic_cast<EvPendingMeshShape*>(object->getCollisionShape());
+  if(pendingShape != nullptr) {
+    RigidbodyData *rbData = reinterpret_cast<RigidbodyData*>(object->getUserPointer());
+    rbData->waitingIndex = physWorld.waitingObjects.size();
+    physWorld.waitingObjects.push_back(object);
+    return;
+  }
+
+  if(physWorld.deterministic) {
+    RigidbodyData *rbData = reinterpret_cast<RigidbodyData*>(object->getUserPointer());
+    rbData->pendingIndex = physWorld.pendingObjects.size();
+    physWorld.pendingObjects.push_back(object);
+    return;
+  }
+
+  _ev_physicsworld_addobjectfiltered(physWorld, object,
+      btBroadphaseProxy::StaticFilter,
+      btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter);
+}
+
+// Statics whose shape is still being built are mirrored once it is ready
+void
+_ev_physicsworld_mirrorstatic(
+    PhysicsWorld &physWorld,
+    btCollisionObject *object)
+{
+  if(physWorld.softWorld == nullptr || !object->isStaticObject()) {
+    return;
+  }
+  if(dynamic_cast<EvPendingMeshShape*>(object->getCollisionShape()) != nullptr) {
+    return;
+  }
+  physWorld.softWorld->addStatic(object);
+}
+
+// Called with the world locked
+EvSoftWorld *
+_ev_physicsworld_softworld(
+    PhysicsWorld &physWorld)
+{
+  if(physWorld.softWorld != nullptr) {
+    return physWorld.softWorld;
+  }
+
+  physWorld.softWorld = new EvSoftWorld(ev2btVec3(physWorld.info.solverParams.gravity));
+
+  btCollisionObjectArray &objects = physWorld.world->getCollisionObjectArray();
+  for(int i = 0; i < objects.size(); ++i) {
+    _ev_physicsworld_mirrorstatic(physWorld, objects[i]);
+  }
+  for(int i = 0; i < physWorld.pendingObjects.size(); ++i) {
+    _ev_physicsworld_mirrorstatic(physWorld, physWorld.pendingObjects[i]);
+  }
+  // Mirrors don't follow streaming, cloth keeps colliding with dormant statics
+  for(int i = 0; i < physWorld.streaming->dormantObjects.size(); ++i) {
+    _ev_physicsworld_mirrorstatic(physWorld, physWorld.streaming->dormantObjects[i]);
+  }
+
+  return physWorld.softWorld;
+}
+
+bool
+_ev_physicsworld_entityorder(
+    const btCollisionObject *a,
+    const btCollisionObject *b)
+{
+  RigidbodyData *rbDataA = reinterpret_cast<RigidbodyData*>(a->getUserPointer());
+  RigidbodyData *rbDataB = reinterpret_cast<RigidbodyData*>(b->getUserPointer());
+  return rbDataA->entt_id < rbDataB->entt_id;
+}
+
+// Objects whose mesh finished building join the world
+void
+_ev_physicsworld_addreadyobjects(
+    PhysicsWorld &physWorld)
+{
+  btAlignedObjectArray<btCollisionObject*> &waiting = physWorld.waitingObjects;
+  for(int i = waiting.size() - 1; i >= 0; --i) {
+    btCollisionObject *object = waiting[i];
+    EvPendingMeshShape *pendingShape = static_cast<EvPendingMeshShape*>(object->getCollisionShape());
+    if(!pendingShape->isReady()) {
+      continue;
+    }
+
+    _ev_physicsworld_forgetdetached(physWorld, reinterpret_cast<RigidbodyData*>(object->getUserPointer()));
+    if(pendingShape->getShape() != nullptr) {
+      object->setCollisionShape(pendingShape->getShape());
+    } else {
+      // Left with the empty placeholder, the object won't collide
+      ev_log_warn("Mesh %s failed to build, its objects are added without collision", pendingShape->getPath());
+    }
+    _ev_physicsworld_addobject(physWorld, object);
+    _ev_physicsworld_mirrorstatic(physWorld, object);
+  }
+}
+
+void
+_ev_physicsworld_flushpending(
+    PhysicsWorld &physWorld)
+{
+  btAlignedObjectArray<btCollisionObject*> &pending = physWorld.pendingObjects;
+  if(pending.size() == 0) {
+    return;
+  }
+
+  std::sort(&pending[0], &pending[0] + pending.size(), _ev_physicsworld_entityorder);
+  for(int i = 0; i < pending.size(); ++i) {
+    reinterpret_cast<RigidbodyData*>(pending[i]->getUserPointer())->pendingIndex = -1;
+    _ev_physicsworld_addobjectfiltered(physWorld, pending[i],
+        btBroadphaseProxy::StaticFilter,
+        btBroadphaseProxy::AllFilter ^ btBroadphaseProxy::StaticFilter);
+  }
+  pending.clear();
+}
+
+void
+_ev_physicsworld_setdeterministic(
+    PhysicsWorld &physWorld,
+    bool deterministic)
+{
+  if(!deterministic) {
+    _ev_physicsworld_flushpending(physWorld);
+    physWorld.deterministic = false;
+    return;
+  }
+
+  btContactSolverInfo &solverInfo = physWorld.world->getSolverInfo();
+  solverInfo.m_solverMode &= ~SOLVER_RANDMIZE_ORDER;
+
+  if(physWorld.deterministic) {
+    return;
+  }
+  physWorld.deterministic = true;
+
+  // Rebuild the world in entity order. The object array, the broadphase's
+  // proxy ids and with them the pair order no longer depend on the order
+  // objects were created in. Rigidbodies go back in with their default
+  // filters, which also resets their LOD tier.
+  std::vector<btCollisionObject*> objects;
+  std::vector<std::pair<int, int>> filters;
+  const btCollisionObjectArray &worldObjects = physWorld.world->getCollisionObjectArray();
+  for(int i = 0; i < worldObjects.size(); ++i) {
+    if(worldObjects[i]->getUserPointer() != nullptr) {
+      objects.push_back(worldObjects[i]);
+    }
+  }
+  if(objects.empty()) {
+    return;
+  }
+  std::sort(objects.begin(), objects.end(), _ev_physicsworld_entityorder);
+  for(btCollisionObject *object : objects) {
+    btBroadphaseProxy *proxy = object->getBroadphaseHandle();
+    filters.push_back(std::make_pair(proxy->m_collisionFilterGroup, proxy->m_collisionFilterMask));
+  }
+
+  physWorld.world->removeCollisionObjects(objects.data(), objects.size());
+  if(physWorld.world->getNumCollisionObjects() == 0) {
+    physWorld.broadphase->resetPool(physWorld.collisionDispatcher);
+  }
+  for(size_t i = 0; i < objects.size(); ++i) {
+    _ev_physicsworld_addobjectfiltered(physWorld, objects[i], filters[i].first, filters[i].second);
+  }
+}
+
+void
+ev_physicsworld_setdeterministic(
+    PhysicsWorldHandle world_handle,
+    bool deterministic)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_WORLD_SETDETERMINISTIC, world_handle, deterministic);
+
+  _ev_physicsworld_setdeterministic(physWorld, deterministic);
+}
+
+U64
+ev_physicsworld_gettick(
+    PhysicsWorldHandle world_handle)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+
+  return physWorld.tick;
+}
+
+U64
+_ev_physicsworld_entityof(
+    const btCollisionObject *object)
+{
+  RigidbodyData *rbData = reinterpret_cast<RigidbodyData*>(object->getUserPointer());
+  return rbData != nullptr ? rbData->entt_id : 0;
+}
+
+// Dormant objects are part of the shared state, which objects are dormant
+// depends on the anchors of each machine
+void
+_ev_physicsworld_hashedobjects(
+    PhysicsWorld &physWorld,
+    btAlignedObjectArray<btCollisionObject*> &objects)
+{
+  const btCollisionObjectArray &inWorld = physWorld.world->getCollisionObjectArray();
+  const btAlignedObjectArray<btCollisionObject*> &dormant = physWorld.streaming->dormantObjects;
+  objects.reserve(inWorld.size() + dormant.size());
+  for(int i = 0; i < inWorld.size(); ++i) {
+    objects.push_back(inWorld[i]);
+  }
+  for(int i = 0; i < dormant.size(); ++i) {
+    objects.push_back(dormant[i]);
+  }
+}
+
+U64
+ev_physicsworld_hashstate(
+    PhysicsWorldHandle world_handle,
+    F32 quantum)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+
+  btAlignedObjectArray<btCollisionObject*> objects;
+  _ev_physicsworld_hashedobjects(physWorld, objects);
+  return physWorld.stateHasher->hash(
+      objects.size() > 0 ? &objects[0] : nullptr, _ev_physicsworld_entityof,
+      objects.size(), quantum);
+}
+
+U32
+ev_physicsworld_hashregions(
+    PhysicsWorldHandle world_handle,
+    F32 quantum,
+    F32 regionSize,
+    RegionHash *out_regions,
+    U32 maxRegions)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+
+  static_assert(sizeof(RegionHash) == sizeof(EvStateHasher::Region), "RegionHash has to match EvStateHasher::Region");
+  btAlignedObjectArray<btCollisionObject*> objects;
+  _ev_physicsworld_hashedobjects(physWorld, objects);
+  return physWorld.stateHasher->hashRegions(
+      objects.size() > 0 ? &objects[0] : nullptr, _ev_physicsworld_entityof,
+      objects.size(), quantum, regionSize,
+      reinterpret_cast<EvStateHasher::Region*>(out_regions), maxRegions);
+}
+
+PhysicsWorldStats
+ev_physicsworld_getstats(
+    PhysicsWorldHandle world_handle)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+
+  return physWorld.stats;
+}
+
+PhysicsWorldHandle
+ev_physicsworld_invalidhandle()
+{
+  return INVALID_WORLD_HANDLE;
+}
+
+void
+ev_physicsworld_destroyworld(
+    PhysicsWorldHandle world_handle)
+{
+  if(world_handle == INVALID_WORLD_HANDLE) {
+    return;
+  }
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  if(physWorld.world == nullptr) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_WORLD_DESTROY, world_handle);
+
+  // Goes first, its mirrors share the statics' shapes
+  delete physWorld.softWorld;
+  physWorld.softWorld = nullptr;
+
+  // Clear constraints
+  for(int i = physWorld.world->getNumConstraints() - 1; i >= 0; --i) {
+    btTypedConstraint *constraint = physWorld.world->getConstraint(i);
+    physWorld.world->removeConstraint(constraint);
+    delete constraint;
+  }
+
+  // Clear characters
+  for(int i = 0; i < physWorld.characters.size(); ++i) {
+    CharacterController *character = physWorld.characters[i];
+    physWorld.world->removeAction(character->controller);
+    physWorld.motionStatePool->release(character->motionState);
+    delete character->controller;
+    delete character;
+  }
+  physWorld.characters.clear();
+
+  // Clear vehicles
+  for(int i = 0; i < physWorld.vehicles.size(); ++i) {
+    VehicleController *vehicle = physWorld.vehicles[i];
+    for(int w = 0; w < vehicle->wheelStates.size(); ++w) {
+      if(vehicle->wheelStates[w] != nullptr) {
+        physWorld.motionStatePool->release(vehicle->wheelStates[w]);
+      }
+    }
+    delete vehicle;
+  }
+  physWorld.vehicles.clear();
+  if(physWorld.vehicleBatch != nullptr) {
+    physWorld.world->removeAction(physWorld.vehicleBatch);
+    delete physWorld.vehicleBatch;
+    physWorld.vehicleBatch = nullptr;
+  }
+
+  // Clear dormant objects
+  for(int i = physWorld.streaming->dormantObjects.size() - 1; i >= 0; --i) {
+    btCollisionObject *object = physWorld.streaming->dormantObjects[i];
+    _ev_rigidbody_releasedata(physWorld, object);
+    delete object;
+  }
+
+  // Clear objects that were never added
+  for(int i = physWorld.pendingObjects.size() - 1; i >= 0; --i) {
+    btCollisionObject *object = physWorld.pendingObjects[i];
+    _ev_rigidbody_releasedata(physWorld, object);
+    delete object;
+  }
+  for(int i = physWorld.waitingObjects.size() - 1; i >= 0; --i) {
+    btCollisionObject *object = physWorld.waitingObjects[i];
+    _ev_rigidbody_releasedata(physWorld, object);
+    delete object;
+  }
+
+  // Clear collision objects
+  auto collisionObjects = physWorld.world->getCollisionObjectArray();
+  for(int i = collisionObjects.size()-1; i >=0; --i) {
+    auto object = collisionObjects[i];
+    _ev_rigidbody_releasedata(physWorld, object);
+
+    physWorld.world->removeCollisionObject(object);
+    delete object;
+  }
+
+  // Clear collision shapes  
+  std::lock_guard<std::mutex> shapeGuard(physWorld.shapeVecMtx);
+
+  for(int i = 0; i < physWorld.collisionShapes.size(); ++i) {
+    delete physWorld.collisionShapes[i];
+    physWorld.collisionShapes[i] = nullptr;
+  }
+
+  delete physWorld.world;
+  delete physWorld.constraintSolver;
+  for(int i = 0; i < physWorld.mlcpSolvers.size(); ++i) {
+    delete physWorld.mlcpSolvers[i];
+  }
+  physWorld.mlcpSolvers.clear();
+  delete physWorld.broadphase;
+  delete physWorld.collisionDispatcher;
+  delete physWorld.collisionConfiguration;
+  delete physWorld.rbDataPool;
+  delete physWorld.motionStatePool;
+  delete physWorld.ghostPairCallback;
+  delete physWorld.streaming;
+  delete physWorld.contactReport;
+  delete physWorld.stateHasher;
+  // Blocks still held elsewhere keep the arena alive until they are freed
+  if(physWorld.arena != nullptr) {
+    physWorld.arena->release();
+  }
+  physWorld.world = nullptr;
+  physWorld.constraintSolver = nullptr;
+  physWorld.broadphase = nullptr;
+  physWorld.collisionDispatcher = nullptr;
+  physWorld.collisionConfiguration = nullptr;
+  physWorld.rbDataPool = nullptr;
+  physWorld.motionStatePool = nullptr;
+  physWorld.ghostPairCallback = nullptr;
+  physWorld.streaming = nullptr;
+  physWorld.contactReport = nullptr;
+  physWorld.stateHasher = nullptr;
+  physWorld.arena = nullptr;
+}
+
+U32
+ev_physicsworld_progress(
+    PhysicsWorldHandle world_handle,
+    F32 deltaTime)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  /* ev_log_trace("Progressing PhysicsWorld { %llu } with delta time { %f }", world_handle, deltaTime); */
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+
+  btClock stepClock;
+  physWorld.world->broadphaseTime = 0;
+  EvArena *previousArena = EvArena::setCurrent(physWorld.arena);
+
+  _ev_physicsworld_addreadyobjects(physWorld);
+  if(physWorld.deterministic) {
+    _ev_physicsworld_flushpending(physWorld);
+  }
+
+  _ev_physicsworld_updatestreaming(physWorld);
+  _ev_physicsworld_updatelod(physWorld);
+
+  // Cloth steps alongside the rigid step and is waited for on the next call
+  if(physWorld.softWorld != nullptr) {
+    if(physWorld.deterministic) {
+      physWorld.softWorld->stepAsync(physWorld.fixedTimeStep, 0, physWorld.fixedTimeStep);
+    } else {
+      physWorld.softWorld->stepAsync(deltaTime, physWorld.maxSubSteps, physWorld.fixedTimeStep);
+    }
+  }
+
+  int stepCount;
+  if(physWorld.deterministic) {
+    // A variable step, not an accumulated one: exactly one tick of exactly
+    // the fixed length, whatever time passed on this machine
+    stepCount = physWorld.world->stepSimulation(physWorld.fixedTimeStep, 0);
+    physWorld.tick++;
+  } else {
+    stepCount = physWorld.world->stepSimulation(deltaTime, physWorld.maxSubSteps, physWorld.fixedTimeStep);
+  }
+
+  // Characters are moved by their controllers, push the result to the game
+  for(int i = 0; i < physWorld.characters.size(); ++i) {
+    CharacterController *character = physWorld.characters[i];
+    character->motionState->setWorldPosition(character->ghost->getWorldTransform().getOrigin());
+  }
+
+  _ev_physicsworld_syncvehicles(physWorld);
+
+  _ev_physicsworld_gathercontacts(physWorld, stepCount);
+
+  // Logged after the step so the kinematic transforms it read come first
+  EV_CAPTURE(EV_CAPTURE_WORLD_PROGRESS, world_handle, deltaTime);
+
+  EvArena::setCurrent(previousArena);
+
+  physWorld.stats.stepTimeMs = stepClock.getTimeMicroseconds() / 1000.f;
+  physWorld.stats.broadphaseTimeMs = physWorld.world->broadphaseTime / 1000.f;
+  physWorld.stats.collisionObjectCount = physWorld.world->getNumCollisionObjects();
+  physWorld.stats.overlappingPairCount = physWorld.broadphase->getOverlappingPairCache()->getNumOverlappingPairs();
+  physWorld.stats.manifoldCount = physWorld.collisionDispatcher->getNumManifolds();
+  physWorld.stats.lodBodyCount = physWorld.world->getNumLodBodies();
+  physWorld.stats.manifoldPoolOverflows = physWorld.collisionDispatcher->manifoldPoolOverflows;
+  physWorld.stats.algorithmPoolOverflows = physWorld.collisionDispatcher->algorithmPoolOverflows;
+  physWorld.stats.arenaOverflows = physWorld.arena != nullptr ? physWorld.arena->getOverflowCount() : 0;
+  physWorld.stats.droppedContactCount = physWorld.contactReport->droppedCount;
+
+  if(PhysicsData.visualizationEnabled && PhysicsData.debugDrawer && !PhysicsData.debugDrawer->windowDestroyed) {
+    /* ev_log_trace("Visualization enabled. Drawing frame from PhysicsWorld { %llu }", world_handle); */
+    PhysicsData.debugDrawer->startFrame();
+    physWorld.world->debugDrawWorld();
+    PhysicsData.debugDrawer->endFrame();
+  }
+
+  return 0;
+}
+
+void
+ev_physicsworld_setsubsteps(
+    PhysicsWorldHandle world_handle,
+    U32 maxSubSteps,
+    F32 fixedTimeStep)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_WORLD_SETSUBSTEPS, world_handle, maxSubSteps, fixedTimeStep);
+
+  physWorld.maxSubSteps = maxSubSteps;
+  physWorld.fixedTimeStep = fixedTimeStep > 0.f ? fixedTimeStep : DEFAULT_FIXED_TIMESTEP;
+}
+
+void
+_ev_physics_setworkerthreads(
+    U32 count)
+{
+  if(count == 0) {
+    return;
+  }
+
+  // Only available when Bullet is built with BT_THREADSAFE
+  btITaskScheduler *scheduler = btCreateDefaultTaskScheduler();
+  if(scheduler == nullptr) {
+    ev_log_warn("Bullet was built without multithreading support, physics islands will be solved sequentially");
+    return;
+  }
+
+  scheduler->setNumThreads(count);
+  btSetTaskScheduler(scheduler);
+
+  delete PhysicsData.taskScheduler;
+  PhysicsData.taskScheduler = scheduler;
+}
+
+I32
+_ev_physics_init()
+{
+  // Bullet starts without any scheduler, worlds and btParallelFor need one
+  // before physics_worker_threads installs the multi-threaded one
+  btSetTaskScheduler(btGetSequentialTaskScheduler());
+
+  // Collision Callbacks
+  gContactStartedCallback = contactStartedCallback;
+  gContactEndedCallback = contactEndedCallback;
+
+  PhysicsData.game_mod = evol_loadmodule_weak("game");
+  if(PhysicsData.game_mod) {
+    imports(PhysicsData.game_mod, (Scene));
+  }
+
+  PhysicsData.asset_mod = evol_loadmodule_weak("assetmanager");
+  if(PhysicsData.asset_mod) {
+    imports(PhysicsData.asset_mod, (Asset, MeshLoader));
+  }
+
+  PhysicsData.shapeCacheDir = DEFAULT_SHAPE_CACHE_DIR;
+  PhysicsData.meshBuilder = new EvMeshBuilder(_ev_meshasset_loadtriangles, DEFAULT_MAX_MESH_BUILDS);
+
+  return 0;
+}
+
+void
+_ev_physics_enablevisualization(
+    bool enable)
+{
+  if(enable) {
+    PhysicsData.debugDrawer = new BulletDbg();
+    for(auto &physWorld : PhysicsData.worlds) {
+      physWorld.world->setDebugDrawer(PhysicsData.debugDrawer);
+    }
+  } else {
+    if(PhysicsData.debugDrawer) {
+      delete PhysicsData.debugDrawer;
+    }
+    for(auto &physWorld : PhysicsData.worlds) {
+      physWorld.world->setDebugDrawer(nullptr);
+    }
+  }
+
+  PhysicsData.visualizationEnabled = enable;
+}
+
+void
+_ev_physics_setmaxmeshbuilds(
+    U32 count)
+{
+  if(count == 0) {
+    return;
+  }
+
+  PhysicsData.meshBuilder->setMaxConcurrentBuilds(count);
+}
+
+// Scenes own their worlds. While a capture is replayed the stub answers for
+// the game, which may not be loaded at all.
+PhysicsWorldHandle
+_ev_physics_sceneworld(
+    GameScene game_scene)
+{
+  if(EvGameStub::isActive()) {
+    return EvGameStub::getSceneWorld((U64)game_scene);
+  }
+
+  PhysicsWorldHandle world_handle = Scene->getPhysicsWorld(game_scene);
+  if(EvCapture::isActive()) {
+    EvCapture::recordSceneWorld((U64)game_scene, world_handle);
+  }
+  return world_handle;
+}
+
+bool
+_ev_physics_startcapture(
+    CONST_STR path)
+{
+  if(path == nullptr) {
+    path = DEFAULT_CAPTURE_PATH;
+  }
+
+  if(!EvCapture::start(path)) {
+    ev_log_warn("Couldn't start physics capture to %s", path);
+    return false;
+  }
+  return true;
+}
+
+void
+_ev_physics_stopcapture()
+{
+  EvCapture::stop();
+}
+
+PhysicsReplayStats
+_ev_physics_replay(
+    CONST_STR path)
+{
+  PhysicsReplayStats result = {};
+
+  // Replaying into a capture would record the replay's own calls
+  if(EvCapture::isActive()) {
+    ev_log_warn("Can't replay %s while a physics capture is running", path);
+    return result;
+  }
+
+  // The game stub answers for every motion state and drops their
+  // write-backs, live worlds would be driven by the capture instead
+  for(const PhysicsWorld &physWorld : PhysicsData.worlds) {
+    if(physWorld.world != nullptr) {
+      ev_log_warn("Can't replay %s while other physics worlds exist", path);
+      return result;
+    }
+  }
+
+  EvReplay replay;
+  EvReplay::Stats stats;
+  if(!replay.run(path, stats)) {
+    ev_log_warn("Couldn't read physics capture %s", path);
+    return result;
+  }
+
+  result.recordCount = stats.recordCount;
+  result.skippedCount = stats.skippedCount;
+  result.stepCount = stats.stepCount;
+  result.totalStepTimeMs = stats.totalStepTimeMs;
+  result.worstStepTimeMs = stats.worstStepTimeMs;
+  return result;
+}
+
+I32 
+_ev_physics_deinit()
+{
+  EvCapture::stop();
+
+  delete PhysicsData.meshBuilder;
+  PhysicsData.meshBuilder = nullptr;
+
+  // The workers can't outlive the module's code
+  if(PhysicsData.taskScheduler != nullptr) {
+    btSetTaskScheduler(btGetSequentialTaskScheduler());
+    delete PhysicsData.taskScheduler;
+    PhysicsData.taskScheduler = nullptr;
+  }
+
+  if(PhysicsData.visualizationEnabled) {
+    delete PhysicsData.debugDrawer;
+  }
+
+  EvArena::uninstall();
+
+  return 0;
+}
+
+// Records under the world's lock, so that the log has the calls in the
+// order they changed the world. For calls that don't hold it already.
+#define EV_CAPTURE_LOCKED(pw, ...) do { \
+    if(EvCapture::isActive()) { \
+      std::lock_guard<std::mutex> captureGuard(PhysicsData.worlds[pw].worldMtx); \
+      EvCapture::record(__VA_ARGS__); \
+    } \
+  } while (0)
+
+// World of an object created through the module, for calls that only get
+// the object
+PhysicsWorldHandle
+_ev_physics_objectworld(
+    const btCollisionObject *object)
+{
+  return reinterpret_cast<const RigidbodyData*>(object->getUserPointer())->world_handle;
+}
+
+#define STORE_COLLISION_SHAPE(pw, x) do { \
+    PhysicsWorld &physWorld = PhysicsData.worlds[pw]; \
+    std::lock_guard<std::mutex> shapeGuard(physWorld.shapeVecMtx); \
+    physWorld.collisionShapes.push_back(x); \
+  } while (0)
+
+CollisionShapeHandle
+_ev_collisionshape_newcapsule(
+  PhysicsWorldHandle world_handle,
+  F32 radius,
+  F32 height)
+{
+  btCollisionShape* capsule = new btCapsuleShape(radius, height);
+
+  STORE_COLLISION_SHAPE(world_handle, capsule);
+
+  EV_CAPTURE_LOCKED(world_handle, EV_CAPTURE_SHAPE_CAPSULE, world_handle, radius, height, (CollisionShapeHandle)capsule);
+
+  return capsule;
+}
+
+CollisionShapeHandle
+_ev_collisionshape_newbox(
+  PhysicsWorldHandle world_handle,
+  Vec3 half_extents)
+{
+  btCollisionShape* box = new btBoxShape(ev2btVec3(half_extents));
+
+  STORE_COLLISION_SHAPE(world_handle, box);
+
+  EV_CAPTURE_LOCKED(world_handle, EV_CAPTURE_SHAPE_BOX, world_handle, half_extents, (CollisionShapeHandle)box);
+
+  return box;
+}
+
+CollisionShapeHandle 
+_ev_collisionshape_newmesh(
+    PhysicsWorldHandle world_handle,
+    CONST_STR mesh_path)
+{
+  AssetHandle mesh_handle = Asset->load(mesh_path);
+  MeshAsset meshAsset = MeshLoader->loadAsset(mesh_handle);
+
+  btStridingMeshInterface* buffer_interface = new btTriangleIndexVertexArray(
+      meshAsset.indexCount / 3,
+      reinterpret_cast<int32_t*>(meshAsset.indexData),
+      meshAsset.indexBuferSize / meshAsset.indexCount * 3,
+      meshAsset.vertexCount,
+      meshAsset.vertexData,
+      meshAsset.vertexBuferSize / meshAsset.vertexCount);
+
+  btCollisionShape* mesh = new btBvhTriangleMeshShape(buffer_interface, true);
+  STORE_COLLISION_SHAPE(world_handle, mesh);
+
+  Asset->free(mesh_handle);
+
+  EV_CAPTURE_LOCKED(world_handle, EV_CAPTURE_SHAPE_MESH, world_handle, mesh_path, (CollisionShapeHandle)mesh);
+
+  return mesh;
+}
+
+// Runs on the thread requesting the mesh, the asset manager is only called
+// from there. The asset's buffers are copied so they can be freed right away,
+// the built mesh owns its data.
+bool
+_ev_meshasset_loadtriangles(
+    const char *path,
+    btTriangleMesh *mesh)
+{
+  AssetHandle mesh_handle = Asset->load(path);
+  MeshAsset meshAsset = MeshLoader->loadAsset(mesh_handle);
+  if(meshAsset.vertexCount == 0 || meshAsset.indexCount < 3) {
+    Asset->free(mesh_handle);
+    return false;
+  }
+
+  U32 stride = meshAsset.vertexBuferSize / meshAsset.vertexCount;
+  const U8 *data = reinterpret_cast<const U8*>(meshAsset.vertexData);
+  mesh->preallocateVertices(meshAsset.vertexCount);
+  for(U32 i = 0; i < meshAsset.vertexCount; i++) {
+    const F32 *position = reinterpret_cast<const F32*>(data + i * stride);
+    mesh->findOrAddVertex(btVector3(position[0], position[1], position[2]), false);
+  }
+
+  const U32 *indices = reinterpret_cast<const U32*>(meshAsset.indexData);
+  mesh->preallocateIndices(meshAsset.indexCount);
+  for(U32 i = 0; i + 2 < meshAsset.indexCount; i += 3) {
+    mesh->addTriangleIndices(indices[i], indices[i + 1], indices[i + 2]);
+  }
+
+  Asset->free(mesh_handle);
+  return true;
+}
+
+void
+_ev_meshasset_getvertices(
+    const MeshAsset &meshAsset,
+    btAlignedObjectArray<btVector3> &vertices)
+{
+  vertices.resize(meshAsset.vertexCount);
+  if(meshAsset.vertexCount == 0) {
+    return;
+  }
+
+  U32 stride = meshAsset.vertexBuferSize / meshAsset.vertexCount;
+  const U8 *data = reinterpret_cast<const U8*>(meshAsset.vertexData);
+  for(U32 i = 0; i < meshAsset.vertexCount; i++) {
+    const F32 *position = reinterpret_cast<const F32*>(data + i * stride);
+    vertices[i].setValue(position[0], position[1], position[2]);
+  }
+}
+
+CollisionShapeHandle
+_ev_collisionshape_newconvexhull(
+    PhysicsWorldHandle world_handle,
+    CONST_STR mesh_path,
+    U32 maxVertices)
+{
+  AssetHandle mesh_handle = Asset->load(mesh_path);
+  MeshAsset meshAsset = MeshLoader->loadAsset(mesh_handle);
+
+  btAlignedObjectArray<btVector3> vertices;
+  _ev_meshasset_getvertices(meshAsset, vertices);
+  Asset->free(mesh_handle);
+
+  EvConvexDecomposition::Hull hull;
+  if(vertices.size() > 0) {
+    EvConvexDecomposition::buildSimplifiedHull(&vertices[0], vertices.size(), maxVertices > 0 ? maxVertices : DEFAULT_HULL_VERTEX_BUDGET, hull);
+  }
+
+  btCollisionShape *hullShape;
+  if(hull.size() >= 4) {
+    hullShape = new btConvexHullShape(hull[0].m_floats, hull.size(), sizeof(btVector3));
+  } else {
+    // Flat or empty meshes don't make a solid hull; a box around the origin
+    // covering the points keeps the shape usable
+    ev_log_warn("Convex hull of %s has %d vertices, using a bounding box instead", mesh_path, hull.size());
+    btVector3 halfExtents(CONVEX_DISTANCE_MARGIN, CONVEX_DISTANCE_MARGIN, CONVEX_DISTANCE_MARGIN);
+    for(int i = 0; i < hull.size(); i++) {
+      halfExtents.setMax(hull[i].absolute());
+    }
+    hullShape = new btBoxShape(halfExtents);
+  }
+  STORE_COLLISION_SHAPE(world_handle, hullShape);
+
+  EV_CAPTURE_LOCKED(world_handle, EV_CAPTURE_SHAPE_CONVEXHULL, world_handle, mesh_path, maxVertices, (CollisionShapeHandle)hullShape);
+
+  return hullShape;
+}
+
+CollisionShapeHandle
+_ev_collisionshape_newcompound(
+    PhysicsWorldHandle world_handle,
+    CollisionShapeHandle *children,
+    Matrix4x4 *transforms,
+    U32 childCount)
+{
+  btCompoundShape *compound = new btCompoundShape(true, childCount);
+
+  for(U32 i = 0; i < childCount; i++) {
+    btTransform childTransform;
+    childTransform.setFromOpenGLMatrix(reinterpret_cast<const btScalar*>(transforms[i]));
+    compound->addChildShape(childTransform, reinterpret_cast<btCollisionShape*>(children[i]));
+  }
+
+  STORE_COLLISION_SHAPE(world_handle, compound);
+
+  EV_CAPTURE_LOCKED(world_handle, EV_CAPTURE_SHAPE_COMPOUND, world_handle,
+      evCaptureArray(children, childCount), evCaptureArray(transforms, childCount),
+      (CollisionShapeHandle)compound);
+
+  return compound;
+}
+
+// Splits a mesh into a compound of convex hulls. Decompositions are cached in
+// the shape cache directory under the hash of the mesh geometry and settings,
+// so each asset only pays for the split once.
+CollisionShapeHandle
+_ev_collisionshape_newdecomposedmesh(
+    PhysicsWorldHandle world_handle,
+    CONST_STR mesh_path,
+    U32 maxHulls,
+    U32 maxVerticesPerHull)
+{
+  AssetHandle mesh_handle = Asset->load(mesh_path);
+  MeshAsset meshAsset = MeshLoader->loadAsset(mesh_handle);
+
+  btAlignedObjectArray<btVector3> vertices;
+  _ev_meshasset_getvertices(meshAsset, vertices);
+  const U32 *indices = reinterpret_cast<const U32*>(meshAsset.indexData);
+
+  EvConvexDecomposition decomposition(
+      maxHulls > 0 ? maxHulls : DEFAULT_DECOMPOSITION_HULL_COUNT,
+      maxVerticesPerHull > 0 ? maxVerticesPerHull : DEFAULT_HULL_VERTEX_BUDGET);
+
+  if(vertices.size() > 0) {
+    U64 key = decomposition.hash(&vertices[0], vertices.size(), indices, meshAsset.indexCount);
+    char cachePath[512];
+    snprintf(cachePath, sizeof(cachePath), "%s/%016" PRIx64 ".evhull", PhysicsData.shapeCacheDir.c_str(), key);
+
+    if(!decomposition.load(cachePath)) {
+      decomposition.compute(&vertices[0], vertices.size(), indices, meshAsset.indexCount);
+      if(!decomposition.save(cachePath)) {
+        ev_log_warn("Couldn't write convex decomposition cache for %s to %s", mesh_path, cachePath);
+      }
+    }
+  }
+  Asset->free(mesh_handle);
+
+  btCompoundShape *compound = new btCompoundShape(true, decomposition.getHullCount());
+  for(U32 i = 0; i < decomposition.getHullCount(); i++) {
+    const EvConvexDecomposition::Hull &hull = decomposition.getHull(i);
+    btConvexHullShape *hullShape = new btConvexHullShape(hull[0].m_floats, hull.size(), sizeof(btVector3));
+    STORE_COLLISION_SHAPE(world_handle, hullShape);
+    compound->addChildShape(btTransform::getIdentity(), hullShape);
+  }
+
+  STORE_COLLISION_SHAPE(world_handle, compound);
+
+  EV_CAPTURE_LOCKED(world_handle, EV_CAPTURE_SHAPE_DECOMPOSEDMESH, world_handle, mesh_path, maxHulls, maxVerticesPerHull, (CollisionShapeHandle)compound);
+
+  return compound;
+}
+
+// Terrain tiles are streamed by creating a heightfield per tile and
+// destroying it with `_ev_collisionshape_destroy` once the tile's body is
+// gone, which also unmaps the heightmap.
+CollisionShapeHandle
+_ev_collisionshape_newheightfield(
+    PhysicsWorldHandle world_handle,
+    CONST_STR heightmap_path,
+    Vec3 scale)
+{
+  EvHeightfieldShape *heightfield = EvHeightfieldShape::fromFile(heightmap_path);
+  if(heightfield == nullptr) {
+    ev_log_error("Couldn't map heightmap %s", heightmap_path);
+    return nullptr;
+  }
+
+  heightfield->setLocalScaling(ev2btVec3(scale));
+  heightfield->buildAccelerator();
+
+  STORE_COLLISION_SHAPE(world_handle, heightfield);
+
+  EV_CAPTURE_LOCKED(world_handle, EV_CAPTURE_SHAPE_HEIGHTFIELD, world_handle, heightmap_path, scale, (CollisionShapeHandle)heightfield);
+
+  return heightfield;
+}
+
+// Loads the asset and returns, the BVH is built on the mesh builder threads.
+// Blocks before loading while the builder's queue is full.
+// Objects created against the handle before it is ready join the world on the
+// first progress call after the build finishes.
+CollisionShapeHandle
+_ev_collisionshape_newmeshasync(
+    PhysicsWorldHandle world_handle,
+    CONST_STR mesh_path)
+{
+  EvPendingMeshShape *shape = PhysicsData.meshBuilder->request(mesh_path);
+  STORE_COLLISION_SHAPE(world_handle, shape);
+
+  EV_CAPTURE_LOCKED(world_handle, EV_CAPTURE_SHAPE_MESHASYNC, world_handle, mesh_path, (CollisionShapeHandle)shape);
+
+  return shape;
+}
+
+bool
+_ev_collisionshape_isready(
+    CollisionShapeHandle shape)
+{
+  EvPendingMeshShape *pendingShape = dynamic_cast<EvPendingMeshShape*>(reinterpret_cast<btCollisionShape*>(shape));
+  return pendingShape == nullptr || pendingShape->isReady();
+}
+
+// A finished async mesh is used directly, so only objects created before it
+// was ready ever hold the placeholder
+btCollisionShape *
+_ev_collisionshape_resolve(
+    CollisionShapeHandle shape)
+{
+  btCollisionShape *collisionShape = reinterpret_cast<btCollisionShape*>(shape);
+  EvPendingMeshShape *pendingShape = dynamic_cast<EvPendingMeshShape*>(collisionShape);
+  if(pendingShape != nullptr && pendingShape->getShape() != nullptr) {
+    return pendingShape->getShape();
+  }
+  return collisionShape;
+}
+
+bool
+_ev_physicsworld_objectsuse(
+    const btAlignedObjectArray<btCollisionObject*> &objects,
+    const btCollisionShape *shape)
+{
+  for(int i = 0; i < objects.size(); ++i) {
+    if(objects[i]->getCollisionShape() == shape) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Whether any object of the world, in it or detached from it, or any
+// compound of the world still points at `shape`. A placeholder also counts
+// as used while objects hold the mesh it built, since it owns that mesh.
+// Called with both worldMtx and shapeVecMtx held.
+bool
+_ev_physicsworld_shapeinuse(
+    PhysicsWorld &physWorld,
+    btCollisionShape *shape)
+{
+  const btCollisionShape *built = nullptr;
+  EvPendingMeshShape *pendingShape = dynamic_cast<EvPendingMeshShape*>(shape);
+  if(pendingShape != nullptr) {
+    built = pendingShape->getShape();
+  }
+
+  const btAlignedObjectArray<btCollisionObject*> *objectLists[] = {
+    &physWorld.world->getCollisionObjectArray(),
+    &physWorld.streaming->dormantObjects,
+    &physWorld.pendingObjects,
+    &physWorld.waitingObjects,
+  };
+  for(const btAlignedObjectArray<btCollisionObject*> *objects : objectLists) {
+    if(_ev_physicsworld_objectsuse(*objects, shape) ||
+       (built != nullptr && _ev_physicsworld_objectsuse(*objects, built))) {
+      return true;
+    }
+  }
+
+  for(int i = 0; i < physWorld.collisionShapes.size(); ++i) {
+    if(!physWorld.collisionShapes[i]->isCompound()) {
+      continue;
+    }
+    const btCompoundShape *compound = static_cast<const btCompoundShape*>(physWorld.collisionShapes[i]);
+    for(int c = 0; c < compound->getNumChildShapes(); ++c) {
+      const btCollisionShape *child = compound->getChildShape(c);
+      if(child == shape || (built != nullptr && child == built)) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+// Shapes still referenced are kept, deleting them would leave the objects
+// and compounds using them dangling
+void
+_ev_collisionshape_destroy(
+    PhysicsWorldHandle world_handle,
+    CollisionShapeHandle shape)
+{
+  if(shape == nullptr) {
+    return;
+  }
+
+  btCollisionShape *collisionShape = reinterpret_cast<btCollisionShape*>(shape);
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  {
+    std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+    EV_CAPTURE(EV_CAPTURE_SHAPE_DESTROY, world_handle, shape);
+
+    std::lock_guard<std::mutex> shapeGuard(physWorld.shapeVecMtx);
+    if(_ev_physicsworld_shapeinuse(physWorld, collisionShape)) {
+      ev_log_warn("Collision shape %p is still in use, not destroyed", shape);
+      return;
+    }
+    physWorld.collisionShapes.remove(collisionShape);
+  }
+
+  delete collisionShape;
+}
+
+void
+_ev_collisionshape_setcachedirectory(
+    CONST_STR path)
+{
+  EV_CAPTURE(EV_CAPTURE_SHAPE_SETCACHEDIRECTORY, path);
+
+  PhysicsData.shapeCacheDir = path;
+}
+
+CollisionShapeHandle
+_ev_collisionshape_newsphere(
+  PhysicsWorldHandle world_handle,
+  F32 radius)
+{
+  btCollisionShape *sphere = new btSphereShape(radius);
+
+  STORE_COLLISION_SHAPE(world_handle, sphere);
+
+  EV_CAPTURE_LOCKED(world_handle, EV_CAPTURE_SHAPE_SPHERE, world_handle, radius, (CollisionShapeHandle)sphere);
+
+  return sphere;
+}
+
+// Bodies moving less than the motion threshold in a step skip the swept test
+// entirely, so only fast movers pay for CCD. Unset values are taken from the
+// shape: the threshold from its bounding radius and the swept sphere from its
+// smallest half extent, which keeps the sphere inside the shape.
+void
+_ev_rigidbody_setupccd(
+    btRigidBody *body,
+    F32 motionThreshold,
+    F32 sweptSphereRadius)
+{
+  btCollisionShape *shape = body->getCollisionShape();
+
+  if(motionThreshold <= 0.f) {
+    btVector3 center;
+    btScalar boundingRadius;
+    shape->getBoundingSphere(center, boundingRadius);
+    motionThreshold = boundingRadius * 0.5f;
+  }
+
+  if(sweptSphereRadius <= 0.f) {
+    btVector3 aabbMin, aabbMax;
+    shape->getAabb(btTransform::getIdentity(), aabbMin, aabbMax);
+    btVector3 halfExtents = (aabbMax - aabbMin) * 0.5f;
+    sweptSphereRadius = halfExtents[halfExtents.minAxis()] * 0.9f;
+  }
+
+  body->setCcdMotionThreshold(motionThreshold);
+  body->setCcdSweptSphereRadius(sweptSphereRadius);
+}
+
+// Statics are plain collision objects: no motion state, no per-step AABB
+// update and no place in the simulation islands or the transform sync. Their
+// transform is read from the game object once.
+RigidbodyHandle
+_ev_rigidbody_newstatic(
+  GameScene game_scene,
+  U64 entt,
+  RigidbodyInfo rbInfo)
+{
+  PhysicsWorldHandle world_handle = _ev_physics_sceneworld(game_scene);
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+
+  btTransform transform;
+  EvMotionState gameObjectState;
+  gameObjectState.setGameObject(entt);
+  gameObjectState.setGameScene(game_scene);
+  gameObjectState.getWorldTransform(transform);
+
+  btCollisionObject *object = new btCollisionObject();
+  object->setCollisionShape(_ev_collisionshape_resolve(rbInfo.collisionShape));
+  object->setWorldTransform(transform);
+  object->setRestitution(rbInfo.restitution);
+  object->setCollisionFlags(btCollisionObject::CF_STATIC_OBJECT);
+  object->setActivationState(ISLAND_SLEEPING);
+
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+
+  RigidbodyData *rbData = physWorld.rbDataPool->acquire();
+  rbData->entt_id = entt;
+  rbData->game_scene = game_scene;
+  rbData->world_handle = world_handle;
+  object->setUserPointer(rbData);
+
+  _ev_physicsworld_addobject(physWorld, object);
+  _ev_physicsworld_mirrorstatic(physWorld, object);
+
+  EV_CAPTURE(EV_CAPTURE_RIGIDBODY_NEW, (U64)game_scene, entt, rbInfo, (RigidbodyHandle)object);
+
+  return object;
+}
+
+// AABBs of sleeping objects are not refreshed by the world. Statics always
+// sleep, and so do ghosts and massless bodies once they stop, so those get
+// their AABB updated here when moved explicitly; active objects are left to
+// the next step. Kinematic bodies take their transform from the game object
+// on the next step, as they always did, but only once their motion state's
+// poll sees a change.
+void
+_ev_rigidbody_refreshmoved(
+    btCollisionObject *object)
+{
+  if(object->isKinematicObject()) {
+    btRigidBody *body = btRigidBody::upcast(object);
+    if(body != nullptr && body->getMotionState() != nullptr) {
+      static_cast<EvMotionState*>(body->getMotionState())->invalidateWorldTransform();
+    }
+    return;
+  }
+  if(!object->isStaticObject() && object->isActive()) {
+    return;
+  }
+
+  RigidbodyData *rbData = reinterpret_cast<RigidbodyData*>(object->getUserPointer());
+  PhysicsWorld &physWorld = PhysicsData.worlds[rbData->world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  if(object->getBroadphaseHandle() != nullptr) {
+    physWorld.world->updateSingleAabb(object);
+  }
+  if(physWorld.softWorld != nullptr) {
+    physWorld.softWorld->updateStatic(object);
+  }
+}
+
+RigidbodyHandle
+_ev_rigidbody_new(
+  GameScene game_scene,
+  U64 entt,
+  RigidbodyInfo rbInfo)
+{
+  if(rbInfo.type == EV_RIGIDBODY_STATIC) {
+    return _ev_rigidbody_newstatic(game_scene, entt, rbInfo);
+  }
+
+  PhysicsWorldHandle world_handle = _ev_physics_sceneworld(game_scene);
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  bool isDynamic = rbInfo.type == EV_RIGIDBODY_DYNAMIC && rbInfo.mass > 0.;
+  bool isGhost = rbInfo.type == EV_RIGIDBODY_GHOST;
+
+  btCollisionShape *collisionShape = _ev_collisionshape_resolve(rbInfo.collisionShape);
+
+  btVector3 localInertia(0.0, 0.0, 0.0);
+
+  if(isDynamic) {
+    collisionShape->calculateLocalInertia(rbInfo.mass, localInertia);
+  }
+
+  physWorld.worldMtx.lock();
+  EvMotionState *motionState = physWorld.motionStatePool->acquire();
+  RigidbodyData *rbData = physWorld.rbDataPool->acquire();
+  physWorld.worldMtx.unlock();
+
+  motionState->setGameObject(entt);
+  motionState->setGameScene(game_scene);
+  btRigidBody::btRigidBodyConstructionInfo btRbInfo(rbInfo.mass, motionState, collisionShape, localInertia);
+  btRbInfo.m_restitution = rbInfo.restitution;
+
+  btRigidBody* body = new btRigidBody(btRbInfo);
+  rbData->entt_id = entt;
+  rbData->game_scene = game_scene;
+  rbData->world_handle = world_handle;
+  body->setUserPointer(rbData);
+
+  if(rbInfo.type == EV_RIGIDBODY_KINEMATIC) {
+    body->setCollisionFlags(btCollisionObject::CF_KINEMATIC_OBJECT);
+    body->setActivationState(DISABLE_DEACTIVATION);
+  }
+
+  if(isGhost) {
+    body->setCollisionFlags(btCollisionObject::CF_NO_CONTACT_RESPONSE);
+  }
+
+  if(isDynamic) {
+    body->setActivationState(DISABLE_DEACTIVATION);
+
+    if(rbInfo.enableCCD) {
+      _ev_rigidbody_setupccd(body, rbInfo.ccdMotionThreshold, rbInfo.ccdSweptSphereRadius);
+    }
+  }
+
+  body->setCollisionFlags(body->getCollisionFlags() | btCollisionObject::CF_CUSTOM_MATERIAL_CALLBACK);
+
+  physWorld.worldMtx.lock();
+  _ev_physicsworld_addobject(physWorld, body);
+  EV_CAPTURE(EV_CAPTURE_RIGIDBODY_NEW, (U64)game_scene, entt, rbInfo, (RigidbodyHandle)body);
+  physWorld.worldMtx.unlock();
+
+  ev_log_trace("New rigidbody added to PhysicsWorld { %llu }. Current rigidbody count in that world = %llu", world_handle, physWorld.world->getNumCollisionObjects());
+
+  return body;
+}
+
+// Characters are ghost objects driven by btKinematicCharacterController:
+// sweep-and-slide movement with step-up and slope limits, resolved against
+// the overlaps the ghost's own pair cache keeps up to date.
+CharacterHandle
+_ev_character_new(
+    GameScene game_scene,
+    U64 entt,
+    CharacterInfo info)
+{
+  btCollisionShape *collisionShape = reinterpret_cast<btCollisionShape*>(info.collisionShape);
+  // The controller sweeps the shape, which only works for convex shapes
+  if(collisionShape == nullptr || !collisionShape->isConvex()) {
+    ev_log_warn("Character shapes must be convex, character for entity %llu not created", (unsigned long long)entt);
+    return nullptr;
+  }
+
+  PhysicsWorldHandle world_handle = _ev_physics_sceneworld(game_scene);
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  btConvexShape *shape = static_cast<btConvexShape*>(collisionShape);
+
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+
+  if(physWorld.ghostPairCallback == nullptr) {
+    physWorld.ghostPairCallback = new btGhostPairCallback();
+    physWorld.broadphase->getOverlappingPairCache()->setInternalGhostPairCallback(physWorld.ghostPairCallback);
+  }
+
+  CharacterController *character = new CharacterController;
+  character->motionState = physWorld.motionStatePool->acquire();
+  character->motionState->setGameObject(entt);
+  character->motionState->setGameScene(game_scene);
+
+  // Characters stay upright, only the position is taken from the game object
+  btTransform objectTransform;
+  character->motionState->getWorldTransform(objectTransform);
+  btTransform startTransform = btTransform::getIdentity();
+  startTransform.setOrigin(objectTransform.getOrigin());
+
+  RigidbodyData *rbData = physWorld.rbDataPool->acquire();
+  rbData->entt_id = entt;
+  rbData->game_scene = game_scene;
+  rbData->world_handle = world_handle;
+
+  character->ghost = new btPairCachingGhostObject();
+  character->ghost->setWorldTransform(startTransform);
+  character->ghost->setCollisionShape(shape);
+  character->ghost->setCollisionFlags(btCollisionObject::CF_CHARACTER_OBJECT);
+  character->ghost->setUserPointer(rbData);
+
+  character->controller = new btKinematicCharacterController(character->ghost, shape, info.stepHeight, btVector3(0, 1, 0));
+  character->controller->setMaxSlope(info.maxSlope);
+  character->controller->setJumpSpeed(info.jumpSpeed);
+  character->controller->setGravity(physWorld.world->getGravity());
+
+  // Bodies on the lower LOD tiers are in the debris group
+  physWorld.world->addCollisionObject(character->ghost,
+      btBroadphaseProxy::CharacterFilter,
+      btBroadphaseProxy::StaticFilter | btBroadphaseProxy::DefaultFilter | btBroadphaseProxy::DebrisFilter);
+  physWorld.world->addAction(character->controller);
+  physWorld.characters.push_back(character);
+
+  EV_CAPTURE(EV_CAPTURE_CHARACTER_NEW, (U64)game_scene, entt, info, (CharacterHandle)character);
+
+  return character;
+}
+
+void
+_ev_character_destroy(
+    GameScene game_scene,
+    CharacterHandle handle)
+{
+  if(handle == nullptr) {
+    return;
+  }
+
+  PhysicsWorldHandle world_handle = _ev_physics_sceneworld(game_scene);
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  CharacterController *character = reinterpret_cast<CharacterController*>(handle);
+
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_CHARACTER_DESTROY, (U64)game_scene, handle);
+
+  physWorld.world->removeAction(character->controller);
+  physWorld.world->removeCollisionObject(character->ghost);
+  physWorld.characters.remove(character);
+
+  _ev_rigidbody_releasedata(physWorld, character->ghost);
+  physWorld.motionStatePool->release(character->motionState);
+
+  delete character->controller;
+  delete character->ghost;
+  delete character;
+}
+
+void
+_ev_character_move(
+    CharacterHandle handle,
+    Vec3 desiredMove,
+    F32 deltaTime)
+{
+  CharacterController *character = reinterpret_cast<CharacterController*>(handle);
+  EV_CAPTURE_LOCKED(_ev_physics_objectworld(character->ghost), EV_CAPTURE_CHARACTER_MOVE, handle, desiredMove, deltaTime);
+
+  if(deltaTime <= 0.f) {
+    return;
+  }
+  character->controller->setVelocityForTimeInterval(ev2btVec3(desiredMove) / deltaTime, deltaTime);
+}
+
+void
+_ev_character_movebatch(
+    CharacterHandle *characters,
+    Vec3 *desiredMoves,
+    U32 count,
+    F32 deltaTime)
+{
+  if(count == 0) {
+    return;
+  }
+  EV_CAPTURE_LOCKED(_ev_physics_objectworld(reinterpret_cast<CharacterController*>(characters[0])->ghost),
+      EV_CAPTURE_CHARACTER_MOVEBATCH, evCaptureArray(characters, count), evCaptureArray(desiredMoves, count), deltaTime);
+
+  if(deltaTime <= 0.f) {
+    return;
+  }
+
+  btScalar invDeltaTime = 1.f / deltaTime;
+  for(U32 i = 0; i < count; i++) {
+    CharacterController *character = reinterpret_cast<CharacterController*>(characters[i]);
+    character->controller->setVelocityForTimeInterval(ev2btVec3(desiredMoves[i]) * invDeltaTime, deltaTime);
+  }
+}
+
+void
+_ev_character_jump(
+    CharacterHandle handle)
+{
+  CharacterController *character = reinterpret_cast<CharacterController*>(handle);
+  EV_CAPTURE_LOCKED(_ev_physics_objectworld(character->ghost), EV_CAPTURE_CHARACTER_JUMP, handle);
+
+  if(character->controller->canJump()) {
+    character->controller->jump();
+  }
+}
+
+bool
+_ev_character_isonground(
+    CharacterHandle handle)
+{
+  CharacterController *character = reinterpret_cast<CharacterController*>(handle);
+  return character->controller->onGround();
+}
+
+// Wheel transforms follow `chassisTransform` instead of the chassis' own, so
+// they line up with the chassis as the game sees it
+void
+_ev_vehicle_syncwheels(
+    VehicleController *controller,
+    const btTransform &chassisTransform)
+{
+  btRaycastVehicle *vehicle = controller->vehicle;
+  btTransform toChassis = chassisTransform * vehicle->getRigidBody()->getCenterOfMassTransform().inverse();
+  for(int i = 0; i < vehicle->getNumWheels(); ++i) {
+    vehicle->updateWheelTransform(i, false);
+    controller->wheelTransforms[i] = toChassis * vehicle->getWheelTransformWS(i);
+    if(controller->wheelStates[i] != nullptr) {
+      controller->wheelStates[i]->setWorldTransform(controller->wheelTransforms[i]);
+    }
+  }
+}
+
+// Called after every step. All wheels of all vehicles are written to the game
+// in one pass, sleeping and dormant vehicles keep their last transforms.
+void
+_ev_physicsworld_syncvehicles(
+    PhysicsWorld &physWorld)
+{
+  for(int i = 0; i < physWorld.vehicles.size(); ++i) {
+    VehicleController *controller = physWorld.vehicles[i];
+    btRigidBody *chassis = controller->vehicle->getRigidBody();
+    if(chassis->getBroadphaseHandle() == nullptr || !chassis->isActive()) {
+      continue;
+    }
+
+    btTransform chassisTransform;
+    physWorld.world->getInterpolatedTransform(chassis, chassisTransform);
+    _ev_vehicle_syncwheels(controller, chassisTransform);
+  }
+}
+
+// Called with the world locked
+void
+_ev_vehicle_release(
+    PhysicsWorld &physWorld,
+    VehicleController *controller)
+{
+  for(int i = 0; i < controller->wheelStates.size(); ++i) {
+    if(controller->wheelStates[i] != nullptr) {
+      physWorld.motionStatePool->release(controller->wheelStates[i]);
+    }
+  }
+  physWorld.vehicleBatch->removeVehicle(controller->vehicle);
+  physWorld.vehicles.remove(controller);
+  delete controller;
+}
+
+// Vehicles are destroyed along with their chassis
+void
+_ev_physicsworld_forgetchassis(
+    PhysicsWorld &physWorld,
+    btCollisionObject *object)
+{
+  for(int i = physWorld.vehicles.size() - 1; i >= 0; --i) {
+    if(physWorld.vehicles[i]->vehicle->getRigidBody() == object) {
+      _ev_vehicle_release(physWorld, physWorld.vehicles[i]);
+    }
+  }
+}
+
+VehicleHandle
+_ev_vehicle_new(
+    GameScene game_scene,
+    RigidbodyHandle chassis_handle,
+    VehicleInfo info,
+    VehicleWheel *wheels,
+    U32 wheelCount)
+{
+  btRigidBody *chassis = btRigidBody::upcast(reinterpret_cast<btCollisionObject*>(chassis_handle));
+  if(chassis == nullptr || chassis->getInvMass() == 0.f) {
+    ev_log_warn("Vehicles need a dynamic rigidbody as their chassis");
+    return nullptr;
+  }
+  if(wheelCount == 0) {
+    ev_log_warn("Vehicles need at least one wheel");
+    return nullptr;
+  }
+
+  PhysicsWorldHandle world_handle = _ev_physics_sceneworld(game_scene);
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+
+  // Bullet's defaults for anything left at zero
+  btRaycastVehicle::btVehicleTuning tuning;
+  if(info.suspensionStiffness > 0.f) {
+    tuning.m_suspensionStiffness = info.suspensionStiffness;
+  }
+  if(info.suspensionCompression > 0.f) {
+    tuning.m_suspensionCompression = info.suspensionCompression;
+  }
+  if(info.suspensionDamping > 0.f) {
+    tuning.m_suspensionDamping = info.suspensionDamping;
+  }
+  if(info.maxSuspensionTravelCm > 0.f) {
+    tuning.m_maxSuspensionTravelCm = info.maxSuspensionTravelCm;
+  }
+  if(info.maxSuspensionForce > 0.f) {
+    tuning.m_maxSuspensionForce = info.maxSuspensionForce;
+  }
+  if(info.frictionSlip > 0.f) {
+    tuning.m_frictionSlip = info.frictionSlip;
+  }
+
+  btVector3 wheelDirection = ev2btVec3(info.wheelDirection);
+  if(wheelDirection.length2() < SIMD_EPSILON) {
+    wheelDirection.setValue(0, -1, 0);
+  }
+  btVector3 wheelAxle = ev2btVec3(info.wheelAxle);
+  if(wheelAxle.length2() < SIMD_EPSILON) {
+    wheelAxle.setValue(-1, 0, 0);
+  }
+
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+
+  if(physWorld.vehicleBatch == nullptr) {
+    physWorld.vehicleBatch = new EvVehicleBatch();
+    physWorld.world->addAction(physWorld.vehicleBatch);
+  }
+
+  VehicleController *controller = new VehicleController;
+  controller->vehicle = physWorld.vehicleBatch->addVehicle(tuning, chassis);
+  // Right, up and forward are the chassis' X, Y and Z axes
+  controller->vehicle->setCoordinateSystem(0, 1, 2);
+
+  controller->drivenWheels.resize(wheelCount);
+  controller->wheelStates.resize(wheelCount);
+  controller->wheelTransforms.resize(wheelCount);
+  for(U32 i = 0; i < wheelCount; i++) {
+    btWheelInfo &wheel = controller->vehicle->addWheel(
+        ev2btVec3(wheels[i].connectionPoint), wheelDirection, wheelAxle,
+        wheels[i].suspensionRestLength, wheels[i].radius,
+        tuning, wheels[i].isFrontWheel);
+    if(info.rollInfluence > 0.f) {
+      wheel.m_rollInfluence = info.rollInfluence;
+    }
+    controller->drivenWheels[i] = wheels[i].isDriven;
+
+    controller->wheelStates[i] = nullptr;
+    if(wheels[i].wheelEntity != 0) {
+      controller->wheelStates[i] = physWorld.motionStatePool->acquire();
+      controller->wheelStates[i]->setGameObject(wheels[i].wheelEntity);
+      controller->wheelStates[i]->setGameScene(game_scene);
+    }
+  }
+  _ev_vehicle_syncwheels(controller, chassis->getCenterOfMassTransform());
+
+  physWorld.vehicles.push_back(controller);
+
+  EV_CAPTURE(EV_CAPTURE_VEHICLE_NEW, (U64)game_scene, chassis_handle, info,
+      evCaptureArray(wheels, wheelCount), (VehicleHandle)controller);
+
+  return controller;
+}
+
+void
+_ev_vehicle_destroy(
+    GameScene game_scene,
+    VehicleHandle handle)
+{
+  if(handle == nullptr) {
+    return;
   }
 
-  return 0;
+  PhysicsWorldHandle world_handle = _ev_physics_sceneworld(game_scene);
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_VEHICLE_DESTROY, (U64)game_scene, handle);
+  _ev_vehicle_release(physWorld, reinterpret_cast<VehicleController*>(handle));
 }
 
-I32
-_ev_physics_init()
+void
+_ev_vehicle_applycontrols(
+    VehicleController *controller,
+    const VehicleControls &controls)
 {
-  // Collision Callbacks
-  gContactStartedCallback = contactStartedCallback;
-  gContactEndedCallback = contactEndedCallback;
-
-  PhysicsData.game_mod = evol_loadmodule_weak("game");
-  if(PhysicsData.game_mod) {
-    imports(PhysicsData.game_mod, (Scene));
+  btRaycastVehicle *vehicle = controller->vehicle;
+  bool wake = controls.engineForce != 0.f;
+  for(int i = 0; i < vehicle->getNumWheels(); ++i) {
+    if(vehicle->getWheelInfo(i).m_bIsFrontWheel) {
+      wake |= vehicle->getSteeringValue(i) != controls.steering;
+      vehicle->setSteeringValue(controls.steering, i);
+    }
+    vehicle->applyEngineForce(controller->drivenWheels[i] ? controls.engineForce : 0.f, i);
+    vehicle->setBrake(controls.brake, i);
   }
 
-  PhysicsData.asset_mod = evol_loadmodule_weak("assetmanager");
-  if(PhysicsData.asset_mod) {
-    imports(PhysicsData.asset_mod, (Asset, MeshLoader));
+  // Parked vehicles sleep until they are driven or steered
+  if(wake) {
+    vehicle->getRigidBody()->activate();
   }
-
-  return 0;
 }
 
 void
-_ev_physics_enablevisualization(
-    bool enable)
+_ev_vehicle_setcontrols(
+    VehicleHandle handle,
+    VehicleControls controls)
 {
-  if(enable) {
-    PhysicsData.debugDrawer = new BulletDbg();
-    for(auto &physWorld : PhysicsData.worlds) {
-      physWorld.world->setDebugDrawer(PhysicsData.debugDrawer);
-    }
-  } else {
-    if(PhysicsData.debugDrawer) {
-      delete PhysicsData.debugDrawer;
-    }
-    for(auto &physWorld : PhysicsData.worlds) {
-      physWorld.world->setDebugDrawer(nullptr);
-    }
-  }
+  VehicleController *controller = reinterpret_cast<VehicleController*>(handle);
+  EV_CAPTURE_LOCKED(_ev_physics_objectworld(controller->vehicle->getRigidBody()), EV_CAPTURE_VEHICLE_SETCONTROLS, handle, controls);
 
-  PhysicsData.visualizationEnabled = enable;
+  _ev_vehicle_applycontrols(controller, controls);
 }
 
-I32 
-_ev_physics_deinit()
+void
+_ev_vehicle_setcontrolsbatch(
+    VehicleHandle *vehicles,
+    VehicleControls *controls,
+    U32 count)
 {
-  if(PhysicsData.visualizationEnabled) {
-    delete PhysicsData.debugDrawer;
+  if(count == 0) {
+    return;
   }
+  EV_CAPTURE_LOCKED(_ev_physics_objectworld(reinterpret_cast<VehicleController*>(vehicles[0])->vehicle->getRigidBody()),
+      EV_CAPTURE_VEHICLE_SETCONTROLSBATCH, evCaptureArray(vehicles, count), evCaptureArray(controls, count));
 
-
-  return 0;
+  for(U32 i = 0; i < count; i++) {
+    _ev_vehicle_applycontrols(reinterpret_cast<VehicleController*>(vehicles[i]), controls[i]);
+  }
 }
 
-#define STORE_COLLISION_SHAPE(pw, x) do { \
-    PhysicsWorld &physWorld = PhysicsData.worlds[pw]; \
-    std::lock_guard<std::mutex> shapeGuard(physWorld.shapeVecMtx); \
-    physWorld.collisionShapes.push_back(x); \
-  } while (0)
-
-CollisionShapeHandle
-_ev_collisionshape_newcapsule(
-  PhysicsWorldHandle world_handle,
-  F32 radius,
-  F32 height)
+F32
+_ev_vehicle_getspeed(
+    VehicleHandle handle)
 {
-  btCollisionShape* capsule = new btCapsuleShape(radius, height);
+  return reinterpret_cast<VehicleController*>(handle)->vehicle->getCurrentSpeedKmHour() / 3.6f;
+}
 
-  STORE_COLLISION_SHAPE(world_handle, capsule);
+U32
+_ev_vehicle_getwheeltransforms(
+    VehicleHandle handle,
+    Matrix4x4 *out_transforms,
+    U32 maxWheels)
+{
+  VehicleController *controller = reinterpret_cast<VehicleController*>(handle);
+  U32 count = btMin(U32(controller->wheelTransforms.size()), maxWheels);
+  for(U32 i = 0; i < count; i++) {
+    controller->wheelTransforms[i].getOpenGLMatrix(reinterpret_cast<btScalar*>(out_transforms[i]));
+  }
+  return count;
+}
 
-  return capsule;
+btTransform
+_ev_constraint_frame(
+    Vec3 pivot,
+    Vec4 rotation)
+{
+  btQuaternion quat(rotation.x, rotation.y, rotation.z, rotation.w);
+  if(quat.length2() < SIMD_EPSILON) {
+    quat = btQuaternion::getIdentity();
+  }
+  return btTransform(quat.normalized(), ev2btVec3(pivot));
 }
 
-CollisionShapeHandle
-_ev_collisionshape_newbox(
-  PhysicsWorldHandle world_handle,
-  Vec3 half_extents)
+btTypedConstraint *
+_ev_constraint_build(
+    const ConstraintInfo &info)
 {
-  btCollisionShape* box = new btBoxShape(ev2btVec3(half_extents));
+  // Statics are plain collision objects and can't be constrained. A static
+  // anchor is expressed by leaving bodyB empty.
+  btRigidBody *rigidA = info.bodyA ? btRigidBody::upcast(reinterpret_cast<btCollisionObject*>(info.bodyA)) : nullptr;
+  if(rigidA == nullptr) {
+    ev_log_error("Constraint bodyA must be a non-static rigidbody");
+    return nullptr;
+  }
+  btRigidBody *bodyB = nullptr;
+  if(info.bodyB) {
+    bodyB = btRigidBody::upcast(reinterpret_cast<btCollisionObject*>(info.bodyB));
+    if(bodyB == nullptr) {
+      ev_log_error("Constraint bodyB must be a non-static rigidbody, leave it empty to attach bodyA to the world");
+      return nullptr;
+    }
+  }
+  btRigidBody &bodyA = *rigidA;
+  btTransform frameA = _ev_constraint_frame(info.pivotA, info.rotationA);
+  btTransform frameB = _ev_constraint_frame(info.pivotB, info.rotationB);
+
+  btTypedConstraint *constraint = nullptr;
+  switch(info.type) {
+    case EV_CONSTRAINT_POINT_TO_POINT:
+      constraint = bodyB
+        ? new btPoint2PointConstraint(bodyA, *bodyB, ev2btVec3(info.pivotA), ev2btVec3(info.pivotB))
+        : new btPoint2PointConstraint(bodyA, ev2btVec3(info.pivotA));
+      break;
+
+    case EV_CONSTRAINT_HINGE:
+      {
+        btHingeConstraint *hinge = bodyB
+          ? new btHingeConstraint(bodyA, *bodyB, frameA, frameB)
+          : new btHingeConstraint(bodyA, frameA);
+        if(info.angularLowerLimit.z < info.angularUpperLimit.z) {
+          hinge->setLimit(info.angularLowerLimit.z, info.angularUpperLimit.z);
+        }
+        constraint = hinge;
+      }
+      break;
+
+    case EV_CONSTRAINT_SLIDER:
+      {
+        btSliderConstraint *slider = bodyB
+          ? new btSliderConstraint(bodyA, *bodyB, frameA, frameB, true)
+          : new btSliderConstraint(bodyA, frameA, true);
+        if(info.linearLowerLimit.x < info.linearUpperLimit.x) {
+          slider->setLowerLinLimit(info.linearLowerLimit.x);
+          slider->setUpperLinLimit(info.linearUpperLimit.x);
+        }
+        constraint = slider;
+      }
+      break;
+
+    case EV_CONSTRAINT_SPRING_6DOF:
+      {
+        btGeneric6DofSpring2Constraint *spring = bodyB
+          ? new btGeneric6DofSpring2Constraint(bodyA, *bodyB, frameA, frameB)
+          : new btGeneric6DofSpring2Constraint(bodyA, frameA);
+        spring->setLinearLowerLimit(ev2btVec3(info.linearLowerLimit));
+        spring->setLinearUpperLimit(ev2btVec3(info.linearUpperLimit));
+        spring->setAngularLowerLimit(ev2btVec3(info.angularLowerLimit));
+        spring->setAngularUpperLimit(ev2btVec3(info.angularUpperLimit));
+
+        btVector3 linearStiffness = ev2btVec3(info.linearStiffness);
+        btVector3 angularStiffness = ev2btVec3(info.angularStiffness);
+        for(int axis = 0; axis < 3; axis++) {
+          if(linearStiffness[axis] > 0.f) {
+            spring->enableSpring(axis, true);
+            spring->setStiffness(axis, linearStiffness[axis]);
+            spring->setDamping(axis, info.damping);
+          }
+          if(angularStiffness[axis] > 0.f) {
+            spring->enableSpring(axis + 3, true);
+            spring->setStiffness(axis + 3, angularStiffness[axis]);
+            spring->setDamping(axis + 3, info.damping);
+          }
+        }
+        constraint = spring;
+      }
+      break;
+
+    case EV_CONSTRAINT_FIXED:
+      constraint = new btFixedConstraint(bodyA, bodyB ? *bodyB : btTypedConstraint::getFixedBody(), frameA, frameB);
+      break;
+  }
 
-  STORE_COLLISION_SHAPE(world_handle, box);
+  if(constraint != nullptr && info.breakingImpulse > 0.f) {
+    constraint->setBreakingImpulseThreshold(info.breakingImpulse);
+  }
 
-  return box;
+  return constraint;
 }
 
-CollisionShapeHandle 
-_ev_collisionshape_newmesh(
+ConstraintHandle
+_ev_constraint_new(
     PhysicsWorldHandle world_handle,
-    CONST_STR mesh_path)
+    ConstraintInfo info)
 {
-  AssetHandle mesh_handle = Asset->load(mesh_path);
-  MeshAsset meshAsset = MeshLoader->loadAsset(mesh_handle);
+  ConstraintHandle handle;
+  _ev_constraint_newbatch(world_handle, &info, 1, &handle);
+  return handle;
+}
 
-  btStridingMeshInterface* buffer_interface = new btTriangleIndexVertexArray(
-      meshAsset.indexCount / 3,
-      reinterpret_cast<int32_t*>(meshAsset.indexData),
-      meshAsset.indexBuferSize / meshAsset.indexCount * 3,
-      meshAsset.vertexCount,
-      meshAsset.vertexData,
-      meshAsset.vertexBuferSize / meshAsset.vertexCount);
+// Ragdoll templates and chains are created in one call under a single lock.
+// Constraints that can't be built are left null in `out_constraints`.
+void
+_ev_constraint_newbatch(
+    PhysicsWorldHandle world_handle,
+    ConstraintInfo *infos,
+    U32 count,
+    ConstraintHandle *out_constraints)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
 
-  btCollisionShape* mesh = new btBvhTriangleMeshShape(buffer_interface, true);
-  STORE_COLLISION_SHAPE(world_handle, mesh);
+  for(U32 i = 0; i < count; i++) {
+    out_constraints[i] = _ev_constraint_build(infos[i]);
+  }
 
-  Asset->free(mesh_handle);
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  for(U32 i = 0; i < count; i++) {
+    if(out_constraints[i] != nullptr) {
+      physWorld.world->addConstraint(reinterpret_cast<btTypedConstraint*>(out_constraints[i]), infos[i].disableCollisionsBetweenBodies);
+    }
+  }
 
-  return mesh;
+  EV_CAPTURE(EV_CAPTURE_CONSTRAINT_NEWBATCH, world_handle, evCaptureArray(infos, count), evCaptureArray(out_constraints, count));
 }
 
-CollisionShapeHandle
-_ev_collisionshape_newsphere(
-  PhysicsWorldHandle world_handle,
-  F32 radius)
+void
+_ev_constraint_destroy(
+    PhysicsWorldHandle world_handle,
+    ConstraintHandle handle)
 {
-  btCollisionShape *sphere = new btSphereShape(radius);
+  if(handle == nullptr) {
+    return;
+  }
 
-  STORE_COLLISION_SHAPE(world_handle, sphere);
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  btTypedConstraint *constraint = reinterpret_cast<btTypedConstraint*>(handle);
 
-  return sphere;
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_CONSTRAINT_DESTROY, world_handle, handle);
+  physWorld.world->removeConstraint(constraint);
+  delete constraint;
 }
 
-RigidbodyHandle
-_ev_rigidbody_new(
-  GameScene game_scene,
-  U64 entt,
-  RigidbodyInfo rbInfo)
+void
+_ev_constraint_setenabled(
+    ConstraintHandle handle,
+    bool enabled)
 {
-  PhysicsWorldHandle world_handle = Scene->getPhysicsWorld(game_scene);
-  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
-  bool isDynamic = rbInfo.type == EV_RIGIDBODY_DYNAMIC && rbInfo.mass > 0.;
-  bool isGhost = rbInfo.type == EV_RIGIDBODY_GHOST;
+  btTypedConstraint *constraint = reinterpret_cast<btTypedConstraint*>(handle);
+  EV_CAPTURE_LOCKED(_ev_physics_objectworld(&constraint->getRigidBodyA()), EV_CAPTURE_CONSTRAINT_SETENABLED, handle, enabled);
 
-  btCollisionShape *collisionShape = reinterpret_cast<btCollisionShape*>(rbInfo.collisionShape);
+  constraint->setEnabled(enabled);
+}
 
-  btVector3 localInertia(0.0, 0.0, 0.0);
+SoftBodyHandle
+_ev_softbody_newcloth(
+    PhysicsWorldHandle world_handle,
+    CONST_STR mesh_path,
+    SoftBodyInfo info)
+{
+  AssetHandle mesh_handle = Asset->load(mesh_path);
+  MeshAsset meshAsset = MeshLoader->loadAsset(mesh_handle);
 
-  if(isDynamic) {
-    collisionShape->calculateLocalInertia(rbInfo.mass, localInertia);
+  btAlignedObjectArray<btVector3> vertices;
+  _ev_meshasset_getvertices(meshAsset, vertices);
+  std::vector<U32> indices(meshAsset.indexCount);
+  if(meshAsset.indexCount > 0) {
+    memcpy(&indices[0], meshAsset.indexData, sizeof(U32) * meshAsset.indexCount);
   }
+  Asset->free(mesh_handle);
 
-  EvMotionState *motionState = new EvMotionState();
-  motionState->setGameObject(entt);
-  motionState->setGameScene(game_scene);
-  btRigidBody::btRigidBodyConstructionInfo btRbInfo(rbInfo.mass, motionState, collisionShape, localInertia);
-  btRbInfo.m_restitution = rbInfo.restitution;
+  if(vertices.size() == 0 || indices.size() < 3) {
+    ev_log_warn("Mesh %s has no triangles, no cloth was created", mesh_path);
+    return nullptr;
+  }
 
-  btRigidBody* body = new btRigidBody(btRbInfo);
-  RigidbodyData *rbData = new RigidbodyData;
-  rbData->entt_id = entt;
-  rbData->game_scene = game_scene;
-  body->setUserPointer(rbData);
+  EvSoftWorld::ClothParams params;
+  params.mass = info.mass;
+  params.stiffness = info.stiffness;
+  params.bendingStiffness = info.bendingStiffness;
+  params.damping = info.damping;
+  params.friction = info.friction;
+  params.iterations = info.iterations;
 
-  if(rbInfo.type == EV_RIGIDBODY_KINEMATIC) {
-    body->setCollisionFlags(btCollisionObject::CF_KINEMATIC_OBJECT);
-    body->setActivationState(DISABLE_DEACTIVATION);
-  }
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
 
-  if(isGhost) {
-    body->setCollisionFlags(btCollisionObject::CF_NO_CONTACT_RESPONSE);
+  EvSoftWorld::Cloth *cloth = _ev_physicsworld_softworld(physWorld)->newCloth(
+      &vertices[0], vertices.size(),
+      &indices[0], indices.size(),
+      _ev_constraint_frame(info.position, info.rotation),
+      params);
+  if(cloth == nullptr) {
+    ev_log_warn("Mesh %s only has degenerate triangles, no cloth was created", mesh_path);
+    return nullptr;
   }
 
-  if(isDynamic) {
-    body->setActivationState(DISABLE_DEACTIVATION);
+  EV_CAPTURE(EV_CAPTURE_SOFTBODY_NEWCLOTH, world_handle, mesh_path, info, (SoftBodyHandle)cloth);
+
+  return cloth;
+}
+
+void
+_ev_softbody_destroy(
+    PhysicsWorldHandle world_handle,
+    SoftBodyHandle handle)
+{
+  if(handle == nullptr) {
+    return;
   }
 
-  body->setCollisionFlags(body->getCollisionFlags() | btCollisionObject::CF_CUSTOM_MATERIAL_CALLBACK);
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_SOFTBODY_DESTROY, world_handle, handle);
 
-  physWorld.worldMtx.lock();
-  physWorld.world->addRigidBody(body);
-  physWorld.worldMtx.unlock();
+  EvSoftWorld::Cloth *cloth = reinterpret_cast<EvSoftWorld::Cloth*>(handle);
+  cloth->owner->destroyCloth(cloth);
+}
 
-  ev_log_trace("New rigidbody added to PhysicsWorld { %llu }. Current rigidbody count in that world = %llu", world_handle, physWorld.world->getNumCollisionObjects());
+void
+_ev_softbody_pinvertex(
+    PhysicsWorldHandle world_handle,
+    SoftBodyHandle handle,
+    U32 vertex,
+    RigidbodyHandle rb)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_SOFTBODY_PINVERTEX, world_handle, handle, vertex, rb);
 
-  return body;
+  EvSoftWorld::Cloth *cloth = reinterpret_cast<EvSoftWorld::Cloth*>(handle);
+  cloth->owner->pinVertex(cloth, vertex, reinterpret_cast<btCollisionObject*>(rb));
+}
+
+void
+_ev_softbody_unpinvertex(
+    PhysicsWorldHandle world_handle,
+    SoftBodyHandle handle,
+    U32 vertex)
+{
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_SOFTBODY_UNPINVERTEX, world_handle, handle, vertex);
+
+  EvSoftWorld::Cloth *cloth = reinterpret_cast<EvSoftWorld::Cloth*>(handle);
+  cloth->owner->unpinVertex(cloth, vertex);
+}
+
+U32
+_ev_softbody_getvertexcount(
+    SoftBodyHandle handle)
+{
+  return reinterpret_cast<EvSoftWorld::Cloth*>(handle)->vertexNodes.size();
+}
+
+// Doesn't lock the world, positions are published by the soft world's step
+// and can be read while the next one runs
+U32
+_ev_softbody_getvertices(
+    SoftBodyHandle handle,
+    F32 *out_positions,
+    U32 maxVertices)
+{
+  return EvSoftWorld::readVertices(reinterpret_cast<EvSoftWorld::Cloth*>(handle), out_positions, maxVertices);
 }
 
 RayHit
@@ -354,7 +2895,9 @@ ev_physics_raytest(
     Vec3 dir,
     float len)
 {
-  PhysicsWorldHandle world_handle = Scene->getPhysicsWorld(scene_handle);
+  PhysicsWorldHandle world_handle = _ev_physics_sceneworld(scene_handle);
+  EV_CAPTURE_LOCKED(world_handle, EV_CAPTURE_RAYTEST, (U64)scene_handle, orig, dir, len);
+
   PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
 
   btVector3 from = ev2btVec3(orig);
@@ -380,8 +2923,11 @@ _ev_rigidbody_setposition(
     RigidbodyHandle rb,
     Vec3 pos)
 {
-  btRigidBody* body = reinterpret_cast<btRigidBody *>(rb);
-  body->getWorldTransform().setOrigin(ev2btVec3(pos));
+  btCollisionObject* object = reinterpret_cast<btCollisionObject *>(rb);
+  EV_CAPTURE_LOCKED(_ev_physics_objectworld(object), EV_CAPTURE_RIGIDBODY_SETPOSITION, rb, pos);
+
+  object->getWorldTransform().setOrigin(ev2btVec3(pos));
+  _ev_rigidbody_refreshmoved(object);
 }
 
 void
@@ -389,8 +2935,13 @@ _ev_rigidbody_setvelocity(
     RigidbodyHandle rb,
     Vec3 vel)
 {
-  btRigidBody* body = reinterpret_cast<btRigidBody *>(rb);
-  body->setLinearVelocity(ev2btVec3(vel));
+  btCollisionObject* object = reinterpret_cast<btCollisionObject *>(rb);
+  EV_CAPTURE_LOCKED(_ev_physics_objectworld(object), EV_CAPTURE_RIGIDBODY_SETVELOCITY, rb, vel);
+
+  btRigidBody* body = btRigidBody::upcast(object);
+  if(body != nullptr) {
+    body->setLinearVelocity(ev2btVec3(vel));
+  }
 }
 
 
@@ -398,8 +2949,8 @@ Vec3
 _ev_rigidbody_getposition(
     RigidbodyHandle rb)
 {
-  btRigidBody* body = reinterpret_cast<btRigidBody *>(rb);
-  btVector3 &position = body->getWorldTransform().getOrigin();
+  btCollisionObject* object = reinterpret_cast<btCollisionObject *>(rb);
+  btVector3 &position = object->getWorldTransform().getOrigin();
   return bt2evVec3(position);
 }
 
@@ -407,7 +2958,10 @@ Vec3
 _ev_rigidbody_getvelocity(
     RigidbodyHandle rb)
 {
-  btRigidBody* body = reinterpret_cast<btRigidBody *>(rb);
+  btRigidBody* body = btRigidBody::upcast(reinterpret_cast<btCollisionObject *>(rb));
+  if(body == nullptr) {
+    return {{ 0.f, 0.f, 0.f }};
+  }
   const btVector3 &velocity = body->getLinearVelocity();
   return bt2evVec3(velocity);
 }
@@ -417,10 +2971,13 @@ _ev_rigidbody_setrotationeuler(
     RigidbodyHandle rb,
     Vec3 rot)
 {
-  btRigidBody* body = reinterpret_cast<btRigidBody *>(rb);
+  btCollisionObject* object = reinterpret_cast<btCollisionObject *>(rb);
+  EV_CAPTURE_LOCKED(_ev_physics_objectworld(object), EV_CAPTURE_RIGIDBODY_SETROTATIONEULER, rb, rot);
+
   btQuaternion rot_quat;
   rot_quat.setEuler(rot.y, rot.x, rot.z);
-  body->getWorldTransform().setRotation(rot_quat);
+  object->getWorldTransform().setRotation(rot_quat);
+  _ev_rigidbody_refreshmoved(object);
 }
 
 void
@@ -428,8 +2985,78 @@ _ev_rigidbody_addforce(
     RigidbodyHandle rb,
     Vec3 f)
 {
-  btRigidBody* body = reinterpret_cast<btRigidBody *>(rb);
-  body->applyCentralForce(ev2btVec3(f));
+  btCollisionObject* object = reinterpret_cast<btCollisionObject *>(rb);
+  EV_CAPTURE_LOCKED(_ev_physics_objectworld(object), EV_CAPTURE_RIGIDBODY_ADDFORCE, rb, f);
+
+  btRigidBody* body = btRigidBody::upcast(object);
+  if(body != nullptr) {
+    body->applyCentralForce(ev2btVec3(f));
+  }
+}
+
+// Drops an object that is outside the world from the dormant store, the
+// pending adds or the objects waiting for a mesh, whichever holds it
+void
+_ev_physicsworld_forgetdetached(
+    PhysicsWorld &physWorld,
+    RigidbodyData *rbData)
+{
+  if(rbData->dormantIndex >= 0) {
+    btAlignedObjectArray<btCollisionObject*> &dormant = physWorld.streaming->dormantObjects;
+    I32 last = dormant.size() - 1;
+    if(rbData->dormantIndex != last) {
+      dormant[rbData->dormantIndex] = dormant[last];
+      reinterpret_cast<RigidbodyData*>(dormant[last]->getUserPointer())->dormantIndex = rbData->dormantIndex;
+    }
+    dormant.pop_back();
+    rbData->dormantIndex = -1;
+  }
+
+  if(rbData->pendingIndex >= 0) {
+    btAlignedObjectArray<btCollisionObject*> &pending = physWorld.pendingObjects;
+    I32 last = pending.size() - 1;
+    if(rbData->pendingIndex != last) {
+      pending[rbData->pendingIndex] = pending[last];
+      reinterpret_cast<RigidbodyData*>(pending[last]->getUserPointer())->pendingIndex = rbData->pendingIndex;
+    }
+    pending.pop_back();
+    rbData->pendingIndex = -1;
+  }
+
+  if(rbData->waitingIndex >= 0) {
+    btAlignedObjectArray<btCollisionObject*> &waiting = physWorld.waitingObjects;
+    I32 last = waiting.size() - 1;
+    if(rbData->waitingIndex != last) {
+      waiting[rbData->waitingIndex] = waiting[last];
+      reinterpret_cast<RigidbodyData*>(waiting[last]->getUserPointer())->waitingIndex = rbData->waitingIndex;
+    }
+    waiting.pop_back();
+    rbData->waitingIndex = -1;
+  }
+}
+
+void
+_ev_rigidbody_releasedata(
+    PhysicsWorld &physWorld,
+    btCollisionObject *object)
+{
+  btRigidBody *body = btRigidBody::upcast(object);
+  if(body != nullptr && body->getMotionState() != nullptr) {
+    physWorld.motionStatePool->release(static_cast<EvMotionState*>(body->getMotionState()));
+    body->setMotionState(nullptr);
+  }
+
+  if(physWorld.softWorld != nullptr) {
+    physWorld.softWorld->forgetObject(object);
+  }
+  _ev_physicsworld_forgetchassis(physWorld, object);
+
+  RigidbodyData *rbData = reinterpret_cast<RigidbodyData*>(object->getUserPointer());
+  if(rbData != nullptr) {
+    _ev_physicsworld_forgetdetached(physWorld, rbData);
+    physWorld.rbDataPool->release(rbData);
+    object->setUserPointer(nullptr);
+  }
 }
 
 void
@@ -437,17 +3064,101 @@ _ev_rigidbody_destroy(
   GameScene game_scene,
   RigidbodyHandle rb)
 {
-  PhysicsWorldHandle world_handle = Scene->getPhysicsWorld(game_scene);
+  PhysicsWorldHandle world_handle = _ev_physics_sceneworld(game_scene);
   PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
-  btRigidBody* body = reinterpret_cast<btRigidBody *>(rb);
+  btCollisionObject* object = reinterpret_cast<btCollisionObject *>(rb);
+  if(object == nullptr) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_RIGIDBODY_DESTROY, (U64)game_scene, rb);
+
+  btRigidBody *body = btRigidBody::upcast(object);
   if(body != nullptr) {
-    delete body->getMotionState();
-    delete reinterpret_cast<RigidbodyData*>(body->getUserPointer());
-    body->setUserPointer(nullptr);
+    while(body->getNumConstraintRefs() > 0) {
+      btTypedConstraint *constraint = body->getConstraintRef(0);
+      physWorld.world->removeConstraint(constraint);
+      delete constraint;
+    }
+  }
+
+  _ev_rigidbody_releasedata(physWorld, object);
+
+  if(object->getWorldArrayIndex() >= 0) {
+    physWorld.world->removeCollisionObject(object);
+  }
+  delete object;
+}
+
+void
+_ev_rigidbody_destroybatch(
+  GameScene game_scene,
+  RigidbodyHandle *rbs,
+  U32 count)
+{
+  if(count == 0) {
+    return;
   }
 
-  physWorld.world->removeRigidBody(body);
-  delete body;
+  PhysicsWorldHandle world_handle = _ev_physics_sceneworld(game_scene);
+  PhysicsWorld &physWorld = PhysicsData.worlds[world_handle];
+  btCollisionObject **objects = reinterpret_cast<btCollisionObject **>(rbs);
+
+  std::vector<EvMotionState*> motionStates;
+  std::vector<RigidbodyData*> rbData;
+  std::vector<btTypedConstraint*> constraints;
+  motionStates.reserve(count);
+  rbData.reserve(count);
+
+  std::lock_guard<std::mutex> guard(physWorld.worldMtx);
+  EV_CAPTURE(EV_CAPTURE_RIGIDBODY_DESTROYBATCH, (U64)game_scene, evCaptureArray(rbs, count));
+
+  // User data is detached before the bodies leave the world so that the
+  // contact-ended callbacks fired while dropping their pairs are ignored.
+  for(U32 i = 0; i < count; i++) {
+    btCollisionObject *object = objects[i];
+    if(object == nullptr) {
+      continue;
+    }
+    btRigidBody *body = btRigidBody::upcast(object);
+    if(body != nullptr && body->getMotionState() != nullptr) {
+      motionStates.push_back(static_cast<EvMotionState*>(body->getMotionState()));
+      body->setMotionState(nullptr);
+    }
+    if(body != nullptr) {
+      for(int c = 0; c < body->getNumConstraintRefs(); c++) {
+        constraints.push_back(body->getConstraintRef(c));
+      }
+    }
+    RigidbodyData *data = reinterpret_cast<RigidbodyData*>(object->getUserPointer());
+    if(data != nullptr) {
+      _ev_physicsworld_forgetdetached(physWorld, data);
+      rbData.push_back(data);
+    }
+    object->setUserPointer(nullptr);
+    if(physWorld.softWorld != nullptr) {
+      physWorld.softWorld->forgetObject(object);
+    }
+    _ev_physicsworld_forgetchassis(physWorld, object);
+  }
+
+  // Constraints between two removed bodies show up twice
+  std::sort(constraints.begin(), constraints.end());
+  constraints.erase(std::unique(constraints.begin(), constraints.end()), constraints.end());
+  physWorld.world->removeConstraints(constraints.data(), constraints.size());
+  for(btTypedConstraint *constraint : constraints) {
+    delete constraint;
+  }
+
+  physWorld.world->removeCollisionObjects(objects, count);
+
+  physWorld.motionStatePool->releaseBatch(motionStates.data(), motionStates.size());
+  physWorld.rbDataPool->releaseBatch(rbData.data(), rbData.size());
+
+  for(U32 i = 0; i < count; i++) {
+    delete objects[i];
+  }
 }
 
 // ==========================
@@ -24,6 +24,7 @@ ev_physicsmod_scriptapi_loader(
 typedef struct {
     RigidbodyHandle rbHandle;
 } RigidbodyComponent;
+_Static_assert(sizeof(RigidbodyComponent) == sizeof(RigidbodyHandle), "RigidbodyComponent must stay a bare handle");
 
 void
 RigidbodyComponentOnRemoveTrigger(
@@ -32,10 +33,8 @@ RigidbodyComponentOnRemoveTrigger(
   RigidbodyComponent *rbComp = ECS->getQueryColumn(query, sizeof(RigidbodyComponent), 1);
   U32 count = ECS->getQueryMatchCount(query);
 
-  for(U32 i = 0; i < count; i++) {
-    RigidbodyComponent rb = rbComp[i];
-    _ev_rigidbody_destroy(0, rb.rbHandle);
-  }
+  // The component column doubles as a contiguous array of handles
+  _ev_rigidbody_destroybatch(0, &rbComp[0].rbHandle, count);
 }
 
 EV_CONSTRUCTOR 
@@ -61,7 +60,12 @@ EV_CONSTRUCTOR
   }
 
   _ev_physics_init();
+  _ev_physics_setworkerthreads(physics_worker_threads);
+  _ev_physics_setmaxmeshbuilds(physics_max_mesh_builds);
   _ev_physics_enablevisualization(visualize_physics);
+  if(physics_capture) {
+    _ev_physics_startcapture(NULL);
+  }
 
   return 0;
 }
@@ -77,6 +81,11 @@ _ev_physics_dispatch_collisionenter(
     U64 enttA,
     U64 enttB)
 {
+  // Not loaded in headless replays
+  if(Script == NULL) {
+    return;
+  }
+
   vec(U64) *enttAList = Script->getCollisionEnterList(scene, enttA);
   vec(U64) *enttBList = Script->getCollisionEnterList(scene, enttB);
 
@@ -94,6 +103,11 @@ _ev_physics_dispatch_collisionleave(
     U64 enttA,
     U64 enttB)
 {
+  // Not loaded in headless replays
+  if(Script == NULL) {
+    return;
+  }
+
   vec(U64) *enttAList = Script->getCollisionLeaveList(scene, enttA);
   vec(U64) *enttBList = Script->getCollisionLeaveList(scene, enttB);
 
@@ -148,20 +162,76 @@ _ev_rigidbody_getcomponentfromentity(
 EV_BINDINGS
 {
     EV_NS_BIND_FN(PhysicsWorld, newWorld    , ev_physicsworld_newworld);
+    EV_NS_BIND_FN(PhysicsWorld, newWorldEx  , ev_physicsworld_newworldex);
+    EV_NS_BIND_FN(PhysicsWorld, getDefaultInfo, ev_physicsworld_getdefaultinfo);
     EV_NS_BIND_FN(PhysicsWorld, invalidHandle    , ev_physicsworld_invalidhandle);
     EV_NS_BIND_FN(PhysicsWorld, destroyWorld, ev_physicsworld_destroyworld);
     EV_NS_BIND_FN(PhysicsWorld, progress    , ev_physicsworld_progress);
+    EV_NS_BIND_FN(PhysicsWorld, setSubSteps , ev_physicsworld_setsubsteps);
+    EV_NS_BIND_FN(PhysicsWorld, setSolverParams, ev_physicsworld_setsolverparams);
+    EV_NS_BIND_FN(PhysicsWorld, getSolverParams, ev_physicsworld_getsolverparams);
+    EV_NS_BIND_FN(PhysicsWorld, freezeStatics, ev_physicsworld_freezestatics);
+    EV_NS_BIND_FN(PhysicsWorld, addAnchor   , ev_physicsworld_addanchor);
+    EV_NS_BIND_FN(PhysicsWorld, setAnchorPosition, ev_physicsworld_setanchorposition);
+    EV_NS_BIND_FN(PhysicsWorld, removeAnchor, ev_physicsworld_removeanchor);
+    EV_NS_BIND_FN(PhysicsWorld, setStreamingRadius, ev_physicsworld_setstreamingradius);
+    EV_NS_BIND_FN(PhysicsWorld, setLodDistances, ev_physicsworld_setloddistances);
+    EV_NS_BIND_FN(PhysicsWorld, setContactReport, ev_physicsworld_setcontactreport);
+    EV_NS_BIND_FN(PhysicsWorld, getContacts , ev_physicsworld_getcontacts);
+    EV_NS_BIND_FN(PhysicsWorld, setDeterministic, ev_physicsworld_setdeterministic);
+    EV_NS_BIND_FN(PhysicsWorld, getTick     , ev_physicsworld_gettick);
+    EV_NS_BIND_FN(PhysicsWorld, hashState   , ev_physicsworld_hashstate);
+    EV_NS_BIND_FN(PhysicsWorld, hashRegions , ev_physicsworld_hashregions);
+    EV_NS_BIND_FN(PhysicsWorld, getStats    , ev_physicsworld_getstats);
 
     EV_NS_BIND_FN(CollisionShape, newBox, _ev_collisionshape_newbox);
     EV_NS_BIND_FN(CollisionShape, newSphere, _ev_collisionshape_newsphere);
     EV_NS_BIND_FN(CollisionShape, newCapsule, _ev_collisionshape_newcapsule);
     EV_NS_BIND_FN(CollisionShape, newMesh, _ev_collisionshape_newmesh);
+    EV_NS_BIND_FN(CollisionShape, newMeshAsync, _ev_collisionshape_newmeshasync);
+    EV_NS_BIND_FN(CollisionShape, isReady, _ev_collisionshape_isready);
+    EV_NS_BIND_FN(CollisionShape, newConvexHull, _ev_collisionshape_newconvexhull);
+    EV_NS_BIND_FN(CollisionShape, newCompound, _ev_collisionshape_newcompound);
+    EV_NS_BIND_FN(CollisionShape, newDecomposedMesh, _ev_collisionshape_newdecomposedmesh);
+    EV_NS_BIND_FN(CollisionShape, newHeightfield, _ev_collisionshape_newheightfield);
+    EV_NS_BIND_FN(CollisionShape, destroy, _ev_collisionshape_destroy);
+    EV_NS_BIND_FN(CollisionShape, setCacheDirectory, _ev_collisionshape_setcachedirectory);
+
+    EV_NS_BIND_FN(Character, newCharacter, _ev_character_new);
+    EV_NS_BIND_FN(Character, destroy, _ev_character_destroy);
+    EV_NS_BIND_FN(Character, move, _ev_character_move);
+    EV_NS_BIND_FN(Character, moveCharacters, _ev_character_movebatch);
+    EV_NS_BIND_FN(Character, jump, _ev_character_jump);
+    EV_NS_BIND_FN(Character, isOnGround, _ev_character_isonground);
+
+    EV_NS_BIND_FN(Vehicle, newVehicle, _ev_vehicle_new);
+    EV_NS_BIND_FN(Vehicle, destroy, _ev_vehicle_destroy);
+    EV_NS_BIND_FN(Vehicle, setControls, _ev_vehicle_setcontrols);
+    EV_NS_BIND_FN(Vehicle, setVehicleControls, _ev_vehicle_setcontrolsbatch);
+    EV_NS_BIND_FN(Vehicle, getSpeed, _ev_vehicle_getspeed);
+    EV_NS_BIND_FN(Vehicle, getWheelTransforms, _ev_vehicle_getwheeltransforms);
+
+    EV_NS_BIND_FN(Constraint, newConstraint, _ev_constraint_new);
+    EV_NS_BIND_FN(Constraint, newConstraints, _ev_constraint_newbatch);
+    EV_NS_BIND_FN(Constraint, destroy, _ev_constraint_destroy);
+    EV_NS_BIND_FN(Constraint, setEnabled, _ev_constraint_setenabled);
+
+    EV_NS_BIND_FN(SoftBody, newCloth, _ev_softbody_newcloth);
+    EV_NS_BIND_FN(SoftBody, destroy, _ev_softbody_destroy);
+    EV_NS_BIND_FN(SoftBody, pinVertex, _ev_softbody_pinvertex);
+    EV_NS_BIND_FN(SoftBody, unpinVertex, _ev_softbody_unpinvertex);
+    EV_NS_BIND_FN(SoftBody, getVertexCount, _ev_softbody_getvertexcount);
+    EV_NS_BIND_FN(SoftBody, getVertices, _ev_softbody_getvertices);
 
     EV_NS_BIND_FN(Rigidbody, setPosition, _ev_rigidbody_setposition);
     EV_NS_BIND_FN(Rigidbody, getPosition, _ev_rigidbody_getposition);
     EV_NS_BIND_FN(Rigidbody, addToEntity, _ev_rigidbody_addtoentity);
     EV_NS_BIND_FN(Rigidbody, getFromEntity, _ev_rigidbody_getfromentity);
     EV_NS_BIND_FN(Rigidbody, addForce, _ev_rigidbody_addforce);
+
+    EV_NS_BIND_FN(PhysicsCapture, start, _ev_physics_startcapture);
+    EV_NS_BIND_FN(PhysicsCapture, stop, _ev_physics_stopcapture);
+    EV_NS_BIND_FN(PhysicsCapture, replay, _ev_physics_replay);
 }
 
 void